@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stddef.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "calc/calc.h"
+#include "calc/expression.h"
+
+namespace calc {
+namespace async {
+    // Jobs run on a pool owned by the library, started on first use with one worker per
+    // hardware thread. Every worker keeps its own queue of job pieces and steals from the
+    // others when it runs dry, so a large batch submitted from one thread is split and
+    // spread across the pool. Workers always take the highest priority piece available;
+    // pieces are short (tens of thousands of elements), so a High job waits at most
+    // for the pieces already running, never for whole Low jobs.
+    enum class Priority {
+        Low,
+        Normal,
+        High
+    };
+
+    enum class Status {
+        Pending,    // queued, not started
+        Running,
+        Completed,
+        Cancelled,
+        Failed      // rejected at submission; see Job::error()
+    };
+
+    struct Options {
+        Priority priority = Priority::Normal;
+        // Called once with the final status, on the worker that finished the job, or on
+        // the calling thread for a job cancelled while pending or rejected at submission.
+        // Keep it short; it holds up the pool.
+        std::function<void(Status)> onComplete;
+    };
+
+    namespace detail {
+        struct JobState;
+    }
+
+    // Shared handle to a submitted job; copies refer to the same job. Dropping every
+    // handle does not cancel it.
+    class CALC_API Job {
+    public:
+        Job() = default;
+        explicit Job(std::shared_ptr<detail::JobState> state) : state_(std::move(state)) {}
+
+        bool valid() const { return state_ != nullptr; }
+        Status status() const;
+        // True once the job is Completed, Cancelled or Failed. Never blocks, so a frame
+        // loop can poll it.
+        bool done() const;
+        // Blocks until the job is done and returns its final status. On a pool worker
+        // (inside another job) the wait runs other queued pieces instead of sleeping.
+        Status wait() const;
+        // Returns false if the job is still not done after timeout.
+        bool waitFor(std::chrono::milliseconds timeout) const;
+        // Asks the job to stop: a pending job is dropped without running, a running one
+        // stops at its next piece or tile boundary and ends Cancelled, and outputs are left
+        // partly written. Returns false when the job had already finished.
+        bool cancel();
+        const std::string& error() const;
+
+    private:
+        std::shared_ptr<detail::JobState> state_;
+    };
+
+    // A job with a value, valid once status() is Completed.
+    template<typename T>
+    class Future : public Job {
+    public:
+        Future() = default;
+        Future(Job job, std::shared_ptr<T> value) : Job(std::move(job)), value_(std::move(value)) {}
+
+        // Waits for the job; the value is default-constructed unless it Completed.
+        const T& get() const {
+            wait();
+            return *value_;
+        }
+
+    private:
+        std::shared_ptr<T> value_;
+    };
+
+    // Runs task on the pool. Inside it, cancelRequested() tells a long task to return.
+    CALC_API Job submit(std::function<void()> task, const Options& options = Options());
+
+    // Runs function() on the pool and keeps its result.
+    template<typename F>
+    auto call(F function, const Options& options = Options()) -> Future<decltype(function())> {
+        using Result = decltype(function());
+        std::shared_ptr<Result> value = std::make_shared<Result>();
+        Job job = submit([value, function]() mutable { *value = function(); }, options);
+        return Future<Result>(std::move(job), std::move(value));
+    }
+
+    // True on a pool worker whose current job has been asked to stop.
+    CALC_API bool cancelRequested();
+
+    // Asynchronous batch operations, split across the pool. The buffers belong to the
+    // caller and must stay alive, and unchanged, until the job is done.
+    CALC_API Job add(const double* a, const double* b, double* out, size_t n, const Options& options = Options());
+    CALC_API Job subtract(const double* a, const double* b, double* out, size_t n, const Options& options = Options());
+    CALC_API Job multiply(const double* a, const double* b, double* out, size_t n, const Options& options = Options());
+    CALC_API Job divide(const double* a, const double* b, double* out, size_t n, const Options& options = Options());
+    CALC_API Job power(const double* base, const double* exponent, double* out, size_t n, const Options& options = Options());
+    CALC_API Job squareRoot(const double* values, double* out, size_t n, const Options& options = Options());
+
+    // Evaluates expression over n rows of columns (Expression::evaluate over columns)
+    // into out. The expression is copied; columns and out must outlive the job. Fails
+    // when the expression is invalid or columns has the wrong count.
+    CALC_API Job evaluate(const Expression& expression, std::vector<const double*> columns, double* out, size_t n,
+                          const Options& options = Options());
+    // Same, into a vector owned by the returned future.
+    CALC_API Future<std::vector<double>> evaluate(const Expression& expression, std::vector<const double*> columns, size_t n,
+                                                  const Options& options = Options());
+}
+}
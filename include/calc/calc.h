@@ -1,3 +1,10 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
 #ifdef _WIN32
     #ifdef CALC_BUILDING_DLL
         #define CALC_API __declspec(dllexport)
@@ -18,4 +25,197 @@ namespace calc {
     CALC_API double power(double base, double exponent);
     CALC_API double squareRoot(double value);
     CALC_API void version(void);
+
+    // Batch variants: out[i] = op(a[i], b[i]) for i in [0, n).
+    // out may be the same buffer as a or b for in-place updates.
+    CALC_API void add(const double* a, const double* b, double* out, size_t n);
+    CALC_API void subtract(const double* a, const double* b, double* out, size_t n);
+    CALC_API void multiply(const double* a, const double* b, double* out, size_t n);
+    CALC_API void divide(const double* a, const double* b, double* out, size_t n);
+    CALC_API void power(const double* base, const double* exponent, double* out, size_t n);
+    CALC_API void squareRoot(const double* values, double* out, size_t n);
+
+    namespace detail {
+        template<typename T> struct Identity { using type = T; };
+        // Keeps T out of argument deduction, like C++20's std::type_identity_t.
+        template<typename T> using NonDeduced = typename Identity<T>::type;
+    }
+
+    // Element-type generic versions of the scalar and batch operations, such as
+    // calc::add<float>(a, b, out, n) or calc::squareRoot<int64_t>(v). The library exports
+    // them for float, double, long double, int32_t and int64_t. T is never deduced, so it
+    // must be spelled out; untemplated calls always reach the double overloads above.
+    //
+    // Integer types wrap around on overflow, truncate quotients toward zero, take the
+    // floor of square roots and raise to negative powers by truncating the reciprocal.
+    // Division by zero, square roots of negative numbers and integer 0 to a negative
+    // power give 0 and raise the sticky flags below, as for double.
+    template<typename T> T add(detail::NonDeduced<T> a, detail::NonDeduced<T> b);
+    template<typename T> T subtract(detail::NonDeduced<T> a, detail::NonDeduced<T> b);
+    template<typename T> T multiply(detail::NonDeduced<T> a, detail::NonDeduced<T> b);
+    template<typename T> T divide(detail::NonDeduced<T> a, detail::NonDeduced<T> b);
+    template<typename T> T power(detail::NonDeduced<T> base, detail::NonDeduced<T> exponent);
+    template<typename T> T squareRoot(detail::NonDeduced<T> value);
+
+    template<typename T> void add(const detail::NonDeduced<T>* a, const detail::NonDeduced<T>* b, detail::NonDeduced<T>* out, size_t n);
+    template<typename T> void subtract(const detail::NonDeduced<T>* a, const detail::NonDeduced<T>* b, detail::NonDeduced<T>* out, size_t n);
+    template<typename T> void multiply(const detail::NonDeduced<T>* a, const detail::NonDeduced<T>* b, detail::NonDeduced<T>* out, size_t n);
+    template<typename T> void divide(const detail::NonDeduced<T>* a, const detail::NonDeduced<T>* b, detail::NonDeduced<T>* out, size_t n);
+    template<typename T> void power(const detail::NonDeduced<T>* base, const detail::NonDeduced<T>* exponent, detail::NonDeduced<T>* out, size_t n);
+    template<typename T> void squareRoot(const detail::NonDeduced<T>* values, detail::NonDeduced<T>* out, size_t n);
+
+    // Expands DECLARE(T) for every exported element type.
+    #define CALC_FOR_EACH_ELEMENT_TYPE(DECLARE) \
+        DECLARE(float) \
+        DECLARE(double) \
+        DECLARE(long double) \
+        DECLARE(int32_t) \
+        DECLARE(int64_t)
+
+    // Explicit instantiations of the templates above for T, preceded by PREFIX.
+    #define CALC_ELEMENT_INSTANTIATIONS(PREFIX, T) \
+        PREFIX T add<T>(T, T); \
+        PREFIX T subtract<T>(T, T); \
+        PREFIX T multiply<T>(T, T); \
+        PREFIX T divide<T>(T, T); \
+        PREFIX T power<T>(T, T); \
+        PREFIX T squareRoot<T>(T); \
+        PREFIX void add<T>(const T*, const T*, T*, size_t); \
+        PREFIX void subtract<T>(const T*, const T*, T*, size_t); \
+        PREFIX void multiply<T>(const T*, const T*, T*, size_t); \
+        PREFIX void divide<T>(const T*, const T*, T*, size_t); \
+        PREFIX void power<T>(const T*, const T*, T*, size_t); \
+        PREFIX void squareRoot<T>(const T*, T*, size_t);
+
+    #define CALC_DECLARE_ELEMENT_TYPE(T) CALC_ELEMENT_INSTANTIATIONS(extern template CALC_API, T)
+    CALC_FOR_EACH_ELEMENT_TYPE(CALC_DECLARE_ELEMENT_TYPE)
+    #undef CALC_DECLARE_ELEMENT_TYPE
+
+    // Error flags reported by the checked variants and the sticky per-thread error state.
+    namespace status {
+        const uint32_t Ok = 0;
+        const uint32_t DivideByZero = 1u << 0;
+        const uint32_t NegativeSquareRoot = 1u << 1;
+    }
+
+    struct Result {
+        double value;     // same value the unchecked function returns (0 on error)
+        uint32_t status;  // status:: flags
+    };
+
+    // Checked variants report errors in the return value instead of tracing them.
+    CALC_API Result divideChecked(double a, double b);
+    CALC_API Result squareRootChecked(double value);
+
+    // Batch checked variants run without early exits and set bit i of errorMask when
+    // element i fails (errorMask holds maskWords(n) words, fully overwritten). The return
+    // value is the OR of every element's flags, so one test per batch finds any error.
+    CALC_API uint32_t divideChecked(const double* a, const double* b, double* out, size_t n, uint64_t* errorMask);
+    CALC_API uint32_t squareRootChecked(const double* values, double* out, size_t n, uint64_t* errorMask);
+
+    inline size_t maskWords(size_t n) {
+        return (n + 63) / 64;
+    }
+
+    inline bool maskTest(const uint64_t* errorMask, size_t i) {
+        return (errorMask[i / 64] >> (i % 64)) & 1u;
+    }
+
+    // Sticky per-thread flags, raised by the scalar divide/squareRoot and by every
+    // checked variant, and kept until cleared. Unchecked batch functions leave them alone.
+    CALC_API uint32_t errors();
+    CALC_API void clearErrors();
+
+    // Non-owning view over a contiguous buffer, used by the span-style overloads below.
+    template<typename T>
+    struct Span {
+        T* data;
+        size_t size;
+
+        Span(T* data, size_t size) : data(data), size(size) {}
+        template<typename U>
+        Span(std::vector<U>& v) : data(v.data()), size(v.size()) {}
+        template<typename U>
+        Span(const std::vector<U>& v) : data(v.data()), size(v.size()) {}
+    };
+
+    // Span overloads process min(a.size, b.size, out.size) elements and return that count.
+    inline size_t add(Span<const double> a, Span<const double> b, Span<double> out) {
+        size_t n = std::min({a.size, b.size, out.size});
+        add(a.data, b.data, out.data, n);
+        return n;
+    }
+
+    inline size_t subtract(Span<const double> a, Span<const double> b, Span<double> out) {
+        size_t n = std::min({a.size, b.size, out.size});
+        subtract(a.data, b.data, out.data, n);
+        return n;
+    }
+
+    inline size_t multiply(Span<const double> a, Span<const double> b, Span<double> out) {
+        size_t n = std::min({a.size, b.size, out.size});
+        multiply(a.data, b.data, out.data, n);
+        return n;
+    }
+
+    inline size_t divide(Span<const double> a, Span<const double> b, Span<double> out) {
+        size_t n = std::min({a.size, b.size, out.size});
+        divide(a.data, b.data, out.data, n);
+        return n;
+    }
+
+    inline size_t power(Span<const double> base, Span<const double> exponent, Span<double> out) {
+        size_t n = std::min({base.size, exponent.size, out.size});
+        power(base.data, exponent.data, out.data, n);
+        return n;
+    }
+
+    inline size_t squareRoot(Span<const double> values, Span<double> out) {
+        size_t n = std::min(values.size, out.size);
+        squareRoot(values.data, out.data, n);
+        return n;
+    }
+
+    // Element-type generic Span overloads; calc::add<float>(a, b, out) accepts vectors.
+    template<typename T>
+    size_t add(Span<const detail::NonDeduced<T>> a, Span<const detail::NonDeduced<T>> b, Span<detail::NonDeduced<T>> out) {
+        size_t n = std::min({a.size, b.size, out.size});
+        add<T>(a.data, b.data, out.data, n);
+        return n;
+    }
+
+    template<typename T>
+    size_t subtract(Span<const detail::NonDeduced<T>> a, Span<const detail::NonDeduced<T>> b, Span<detail::NonDeduced<T>> out) {
+        size_t n = std::min({a.size, b.size, out.size});
+        subtract<T>(a.data, b.data, out.data, n);
+        return n;
+    }
+
+    template<typename T>
+    size_t multiply(Span<const detail::NonDeduced<T>> a, Span<const detail::NonDeduced<T>> b, Span<detail::NonDeduced<T>> out) {
+        size_t n = std::min({a.size, b.size, out.size});
+        multiply<T>(a.data, b.data, out.data, n);
+        return n;
+    }
+
+    template<typename T>
+    size_t divide(Span<const detail::NonDeduced<T>> a, Span<const detail::NonDeduced<T>> b, Span<detail::NonDeduced<T>> out) {
+        size_t n = std::min({a.size, b.size, out.size});
+        divide<T>(a.data, b.data, out.data, n);
+        return n;
+    }
+
+    template<typename T>
+    size_t power(Span<const detail::NonDeduced<T>> base, Span<const detail::NonDeduced<T>> exponent, Span<detail::NonDeduced<T>> out) {
+        size_t n = std::min({base.size, exponent.size, out.size});
+        power<T>(base.data, exponent.data, out.data, n);
+        return n;
+    }
+
+    template<typename T>
+    size_t squareRoot(Span<const detail::NonDeduced<T>> values, Span<detail::NonDeduced<T>> out) {
+        size_t n = std::min(values.size, out.size);
+        squareRoot<T>(values.data, out.data, n);
+        return n;
+    }
 }
\ No newline at end of file
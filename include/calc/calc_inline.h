@@ -0,0 +1,102 @@
+#pragma once
+
+#include <math.h>
+
+// Header-only mirror of the calc operations.
+//
+// These have the same results as the exported calc:: functions but compile into the
+// caller, so they can be inlined, vectorized inside the caller's loops and folded when
+// the inputs are constants. add, subtract, multiply and divide are constexpr; power and
+// squareRoot are not (libm is not constexpr in C++17), but GCC and Clang still fold
+// them for constant arguments. Unlike the exported functions they emit no trace points.
+// GCC and Clang only vectorize loops over divide and squareRoot when the caller is built
+// with -fno-trapping-math -fno-math-errno, as the calc library itself is.
+//
+// calc::ipow, at the end, has no exported counterpart.
+namespace calc {
+namespace inline_ {
+    constexpr double add(double a, double b) {
+        return a + b;
+    }
+
+    constexpr double subtract(double a, double b) {
+        return a - b;
+    }
+
+    constexpr double multiply(double a, double b) {
+        return a * b;
+    }
+
+    // Division by zero yields 0, as in calc::divide.
+    constexpr double divide(double a, double b) {
+        return b == 0 ? 0.0 : a / b;
+    }
+
+    // Largest |exponent| power() evaluates with multiplications. Each squaring doubles
+    // the relative error of the base, so longer chains drift past pow()'s accuracy.
+    constexpr int POWER_CHAIN_LIMIT = 4;
+
+    // x^n by repeated squaring: the bits of n, lowest first, select the squares of x
+    // that are multiplied into the result.
+    constexpr double integerPower(double x, unsigned n) {
+        double r = 1.0;
+        while (n) {
+            if (n & 1) {
+                r *= x;
+            }
+            n >>= 1;
+            if (n) {
+                x *= x;
+            }
+        }
+        return r;
+    }
+
+    // The same chain unrolled at compile time; bit-identical to integerPower(x, N).
+    template<unsigned N>
+    constexpr double integerPower(double r, double p) {
+        if constexpr (N & 1) {
+            r *= p;
+        }
+        if constexpr (N > 1) {
+            return integerPower<N / 2>(r, p * p);
+        } else {
+            return r;
+        }
+    }
+
+    // Integer exponents up to POWER_CHAIN_LIMIT in magnitude become multiplications
+    // (within 4 ULP; x^2 is correctly rounded), unless the result leaves the normal
+    // range, where pow() keeps subnormals and overflow exact. Others go to pow().
+    inline double power(double base, double exponent) {
+        if (exponent == 2.0) {
+            return base * base;
+        }
+        if (fabs(exponent) <= POWER_CHAIN_LIMIT && exponent == (double)(int)exponent) {
+            int n = (int)exponent;
+            double r = integerPower(base, (unsigned)(n < 0 ? -n : n));
+            if (isnormal(r)) {
+                return n < 0 ? 1.0 / r : r;
+            }
+        }
+        return pow(base, exponent);
+    }
+
+    // The square root of a negative number yields 0, as in calc::squareRoot.
+    inline double squareRoot(double value) {
+        return sqrt(value < 0 ? 0.0 : value);
+    }
+}
+
+    // x^N with the multiplication chain unrolled at compile time; ipow<3>(x) is x*x*x.
+    // Unlike power() there is no pow() fallback and no limit on N, so the error grows
+    // by roughly 0.8 ULP per unit of |N| and intermediates may overflow or underflow.
+    template<int N>
+    constexpr double ipow(double x) {
+        if constexpr (N < 0) {
+            return 1.0 / inline_::integerPower<(unsigned)-N>(1.0, x);
+        } else {
+            return inline_::integerPower<(unsigned)N>(1.0, x);
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "calc/calc.h"
+
+namespace calc {
+    // Instruction set levels the batch operations and calc::kernels are built for.
+    // Every level produces bit-identical results; only the speed differs. The exceptions
+    // are polynomial evaluation (calc/poly.h) and matrix products (calc/matrix.h), which
+    // fuse multiply-adds where the level has them.
+    enum class Isa {
+        Generic,    // the compiler's baseline (SSE2 on x86-64, NEON on AArch64)
+        Avx2,       // AVX2 + FMA
+        Avx512      // AVX-512 F + DQ
+    };
+
+    // The level is picked once, on the first batch or kernel call, as the best one this
+    // build contains and the CPU and OS support. Setting CALC_ISA=generic|avx2|avx512 in
+    // the environment caps it, for testing and benchmarking; a level the machine cannot
+    // run falls back to the best one below it.
+    namespace cpu {
+        CALC_API Isa active();
+        // Whether this build contains the level and this machine can run it.
+        CALC_API bool supported(Isa isa);
+        CALC_API const char* name(Isa isa);
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "calc/calc.h"
+#include "calc/expression.h"
+
+namespace calc {
+    // A table of named double columns in a file, mapped into memory rather than loaded,
+    // so it can be far larger than RAM.
+    //
+    // Binary files hold native-endian doubles, either as records of one value per
+    // column (Layout::Rows, as written by a row-major array dump) or as one whole column
+    // after another (Layout::Columns). CSV files start with a header line of column
+    // names, followed by one row of numbers per line; fields are separated by commas
+    // and may not be quoted. An empty field reads as NaN.
+    class CALC_API Dataset {
+    public:
+        enum class Layout {
+            Rows,
+            Columns
+        };
+
+        Dataset() = default;
+        ~Dataset();
+        Dataset(const Dataset&) = delete;
+        Dataset& operator=(const Dataset&) = delete;
+
+        // Both return false and fill error (when given) if the file cannot be mapped or
+        // does not fit the format; the dataset is left closed.
+        bool openBinary(const std::string& path, const std::vector<std::string>& columns, Layout layout, std::string* error = nullptr);
+        bool openCsv(const std::string& path, std::string* error = nullptr);
+        void close();
+
+        bool isOpen() const { return data_ != nullptr; }
+        bool isCsv() const { return csv_; }
+        const std::vector<std::string>& columns() const { return columns_; }
+        // Index of a column by name, or -1.
+        int columnIndex(const std::string& name) const;
+        // Rows of a binary dataset; CSV rows are only counted as they are read, so 0.
+        size_t rows() const { return rows_; }
+
+    private:
+        friend struct DatasetReader;
+
+        std::vector<std::string> columns_;
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+        size_t start_ = 0;      // first byte after the CSV header
+        size_t rows_ = 0;
+        Layout layout_ = Layout::Rows;
+        bool csv_ = false;
+        void* mapping_ = nullptr;   // platform handle kept for close()
+    };
+
+    struct DatasetOptions {
+        // Threads evaluating chunks in parallel, the caller included; 0 uses one per
+        // hardware thread. The results do not depend on it.
+        unsigned threads = 0;
+    };
+
+    // Receives consecutive results in row order: values[i] belongs to row first + i.
+    // Calls never overlap. Returning false stops the evaluation.
+    using DatasetSink = std::function<bool(size_t first, const double* values, size_t count)>;
+
+    // Evaluates expression for every row of dataset, binding each variable to the
+    // column of the same name. The rows are cut into chunks that threads evaluate in
+    // cache-sized tiles with the batch kernels (Expression::evaluate over columns); only
+    // the columns the expression uses are read, and binary column files are used in
+    // place. Returns false with error set when a variable has no column, a CSV field
+    // is not a number, or sink stops the run; rows before the failure have been
+    // delivered.
+    CALC_API bool evaluate(const Expression& expression, const Dataset& dataset, const DatasetSink& sink,
+                           const DatasetOptions& options = DatasetOptions(), std::string* error = nullptr);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "calc/calc.h"
+
+namespace calc {
+    enum class OpCode : uint8_t {
+        Neg,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Power,
+        SquareRoot
+    };
+
+    // Register-based instruction: regs[dst] = op(regs[a], regs[b]).
+    struct Instruction {
+        OpCode op;
+        uint16_t dst;
+        uint16_t a;
+        uint16_t b;
+    };
+
+    // An arithmetic expression compiled once into bytecode and evaluated many times.
+    //
+    // Syntax: numbers, variables, + - * / ^, unary minus, parentheses and the calls
+    // pow(a, b), sqrt(x), add, subtract, multiply, divide, power and squareRoot.
+    // Operations keep the calc:: semantics: division by zero and the square root of a
+    // negative number both yield 0.
+    //
+    // Register layout: [variables][constants][temporaries]. Variables are numbered in
+    // order of first appearance; constants are folded and deduplicated at compile time
+    // and identical subexpressions are computed once.
+    class CALC_API Expression {
+    public:
+        Expression();
+        explicit Expression(const std::string& source);
+
+        // Returns false and fills error (when given) if the source does not parse.
+        bool compile(const std::string& source, std::string* error = nullptr);
+        bool valid() const { return valid_; }
+
+        const std::string& source() const { return source_; }
+        const std::vector<std::string>& variables() const { return variables_; }
+        // Index of a variable in the values array, or -1 if the expression does not use it.
+        int variableIndex(const std::string& name) const;
+
+        // values holds one entry per variable, in variables() order.
+        double evaluate(const double* values) const;
+        double evaluate(const std::vector<double>& values) const { return evaluate(values.data()); }
+        // Same, using caller-provided scratch of at least registerCount() doubles.
+        double evaluate(const double* values, double* registers) const;
+        // Evaluates n rows at once: columns[v] holds the n values of variable v, in
+        // variables() order, and out receives the n results. Runs the batch kernels over
+        // cache-sized tiles of rows and gives the same results as evaluating each row.
+        void evaluate(const double* const* columns, double* out, size_t n) const;
+
+        const std::vector<Instruction>& code() const { return code_; }
+        const std::vector<double>& constants() const { return constants_; }
+        size_t registerCount() const { return registerCount_; }
+        uint16_t resultRegister() const { return result_; }
+        std::string disassemble() const;
+
+    private:
+        std::string source_;
+        std::vector<std::string> variables_;
+        std::vector<double> constants_;
+        std::vector<Instruction> code_;
+        size_t registerCount_;
+        uint16_t result_;
+        bool valid_;
+    };
+}
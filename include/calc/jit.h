@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include "calc/calc.h"
+#include "calc/expression.h"
+
+namespace calc {
+    // Native tier for a compiled Expression.
+    //
+    // On x86-64 Linux the bytecode is translated into SSE2 machine code placed in
+    // mmap'd pages that are remapped read+execute before use. Everywhere else, or when
+    // CALC_JIT=0 is set in the environment, evaluate() runs the bytecode interpreter.
+    // Results match Expression::evaluate bit for bit.
+    class CALC_API JitExpression {
+    public:
+        explicit JitExpression(const Expression& expression);
+        ~JitExpression();
+
+        JitExpression(const JitExpression&) = delete;
+        JitExpression& operator=(const JitExpression&) = delete;
+
+        // True when native code was generated; false means evaluate() interprets.
+        bool native() const { return function_ != nullptr; }
+        const Expression& expression() const { return expression_; }
+
+        double evaluate(const double* values) const {
+            return function_ ? function_(values) : expression_.evaluate(values);
+        }
+        double evaluate(const std::vector<double>& values) const { return evaluate(values.data()); }
+
+        // Whether this build and process can generate native code at all.
+        static bool available();
+
+    private:
+        using Function = double (*)(const double* values);
+
+        Expression expression_;
+        Function function_;
+        void* memory_;
+        size_t size_;
+    };
+}
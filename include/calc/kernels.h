@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include "calc/calc.h"
+
+namespace calc {
+    // Accuracy tiers for the array kernels, as maximum error in units in the last place
+    // for normal, finite results.
+    enum class Accuracy {
+        Reference,  // platform libm one element at a time (sqrt correctly rounded; glibc
+                    // exp/log/pow/sin/cos are within 1 ULP and almost always correctly rounded)
+        Ulp1,       // vectorized, <= 1 ULP
+        Fast        // vectorized, <= 4 ULP, shorter polynomials
+    };
+
+    // Vectorizable transcendental kernels: out[i] = f(x[i]) for i in [0, n).
+    //
+    // These follow IEEE/libm conventions (NaN for a negative sqrt or log argument,
+    // infinities on overflow), not the zero-on-error rules of calc::squareRoot and
+    // calc::divide. Elements outside a kernel's fast range (sin/cos beyond |x| = 1e5,
+    // pow with non-positive bases, special values) are finished by libm, so every
+    // input is handled. out may be the same buffer as an input.
+    namespace kernels {
+        CALC_API void sqrt(const double* x, double* out, size_t n, Accuracy accuracy = Accuracy::Ulp1);
+        CALC_API void rsqrt(const double* x, double* out, size_t n, Accuracy accuracy = Accuracy::Ulp1);
+        CALC_API void exp(const double* x, double* out, size_t n, Accuracy accuracy = Accuracy::Ulp1);
+        CALC_API void log(const double* x, double* out, size_t n, Accuracy accuracy = Accuracy::Ulp1);
+        CALC_API void sin(const double* x, double* out, size_t n, Accuracy accuracy = Accuracy::Ulp1);
+        CALC_API void cos(const double* x, double* out, size_t n, Accuracy accuracy = Accuracy::Ulp1);
+        CALC_API void pow(const double* base, const double* exponent, double* out, size_t n, Accuracy accuracy = Accuracy::Ulp1);
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <initializer_list>
+#include <vector>
+#include "calc/calc.h"
+
+namespace calc {
+    // Dense vector of doubles.
+    class CALC_API Vector {
+    public:
+        Vector() = default;
+        explicit Vector(size_t size, double value = 0.0) : values_(size, value) {}
+        Vector(std::initializer_list<double> values) : values_(values) {}
+
+        size_t size() const { return values_.size(); }
+        double* data() { return values_.data(); }
+        const double* data() const { return values_.data(); }
+        double& operator[](size_t i) { return values_[i]; }
+        double operator[](size_t i) const { return values_[i]; }
+        Span<double> span() { return Span<double>(values_); }
+        Span<const double> span() const { return Span<const double>(values_); }
+
+        // Resizes to size elements, all set to value.
+        void assign(size_t size, double value = 0.0) { values_.assign(size, value); }
+
+    private:
+        std::vector<double> values_;
+    };
+
+    // Dense matrix of doubles in row-major, contiguous storage: element (r, c) is at
+    // data()[r * cols() + c].
+    class CALC_API Matrix {
+    public:
+        Matrix() = default;
+        Matrix(size_t rows, size_t cols, double value = 0.0) : rows_(rows), cols_(cols), values_(rows * cols, value) {}
+        // Rows given as lists of equal length; shorter rows are padded with zeros.
+        Matrix(std::initializer_list<std::initializer_list<double>> rows);
+        static Matrix identity(size_t n);
+
+        size_t rows() const { return rows_; }
+        size_t cols() const { return cols_; }
+        size_t size() const { return values_.size(); }
+        double* data() { return values_.data(); }
+        const double* data() const { return values_.data(); }
+        double* row(size_t r) { return values_.data() + r * cols_; }
+        const double* row(size_t r) const { return values_.data() + r * cols_; }
+        double& operator()(size_t r, size_t c) { return values_[r * cols_ + c]; }
+        double operator()(size_t r, size_t c) const { return values_[r * cols_ + c]; }
+        Span<double> span() { return Span<double>(values_); }
+        Span<const double> span() const { return Span<const double>(values_); }
+
+        // Reshapes to rows x cols, every element set to value.
+        void assign(size_t rows, size_t cols, double value = 0.0);
+
+    private:
+        size_t rows_ = 0;
+        size_t cols_ = 0;
+        std::vector<double> values_;
+    };
+
+    struct MatrixOptions {
+        // Threads to split large products across, the caller included; 0 uses one per
+        // hardware thread. Results are the same for every thread count.
+        unsigned threads = 0;
+    };
+
+    // Matrix product out = a b and matrix-vector product out = a x. out is reshaped to
+    // fit and may be the same object as an operand. Returns false, leaving out
+    // unchanged, when the inner dimensions differ.
+    //
+    // Products run cache-blocked on the dispatched kernels with fused multiply-adds where
+    // the instruction set level has them, so like calc::polyval their last bits depend
+    // on the level, and sums are not taken in plain loop order.
+    CALC_API bool multiply(const Matrix& a, const Matrix& b, Matrix& out, const MatrixOptions& options = MatrixOptions());
+    CALC_API bool multiply(const Matrix& a, const Vector& x, Vector& out, const MatrixOptions& options = MatrixOptions());
+
+    CALC_API Matrix transpose(const Matrix& a);
+
+    // Elementwise operations with the calc::add ... calc::divide semantics (division by
+    // zero gives 0). out is reshaped to fit and may be the same object as an operand.
+    // Returns false, leaving out unchanged, when the shapes differ.
+    CALC_API bool add(const Matrix& a, const Matrix& b, Matrix& out);
+    CALC_API bool subtract(const Matrix& a, const Matrix& b, Matrix& out);
+    CALC_API bool multiplyElements(const Matrix& a, const Matrix& b, Matrix& out);
+    CALC_API bool divideElements(const Matrix& a, const Matrix& b, Matrix& out);
+
+    CALC_API bool add(const Vector& a, const Vector& b, Vector& out);
+    CALC_API bool subtract(const Vector& a, const Vector& b, Vector& out);
+    CALC_API bool multiplyElements(const Vector& a, const Vector& b, Vector& out);
+    CALC_API bool divideElements(const Vector& a, const Vector& b, Vector& out);
+}
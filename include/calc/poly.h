@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include "calc/calc.h"
+
+namespace calc {
+    // Polynomial evaluation. Coefficients are in ascending order: coeffs[k] multiplies
+    // x^k (or T_k for the Chebyshev forms), and coeffs holds degree + 1 entries.
+    //
+    // The array forms run one Horner (or Clenshaw) chain per element, many elements at a
+    // time, with fused multiply-adds on AVX2/AVX-512 and AArch64. Because of the fusing,
+    // their last bits depend on the instruction set level, unlike the other batch
+    // operations (see calc/cpu.h). out may be the same buffer as x.
+    CALC_API void polyval(const double* coeffs, size_t degree, const double* x, double* out, size_t n);
+
+    // One value by Estrin's scheme, which has a shorter dependency chain than Horner for
+    // high degrees; it rounds differently, so results can differ from the array form in
+    // the last bits.
+    CALC_API double polyval(const double* coeffs, size_t degree, double x);
+
+    // Chebyshev series sum coeffs[k] * T_k(t) with t = x mapped from [lo, hi] onto [-1, 1],
+    // evaluated with Clenshaw's recurrence. Inside the interval no intermediate exceeds
+    // the sum of |coeffs[k]|, so high degrees neither overflow nor lose accuracy the way
+    // the equivalent monomial form can.
+    CALC_API void chebval(const double* coeffs, size_t degree, const double* x, double* out, size_t n, double lo = -1.0, double hi = 1.0);
+    CALC_API double chebval(const double* coeffs, size_t degree, double x, double lo = -1.0, double hi = 1.0);
+
+    namespace inline_ {
+        template<size_t K>
+        constexpr double hornerStep(const double* coeffs, double x, double r) {
+            if constexpr (K == 0) {
+                return r;
+            } else {
+                return hornerStep<K - 1>(coeffs, x, r * x + coeffs[K - 1]);
+            }
+        }
+    }
+
+    // Compile-time degree: the Horner chain is unrolled into the caller, and the array
+    // form's loop over elements is left for the caller's compiler to vectorize (and to
+    // contract into FMAs when the caller is built for a target that has them).
+    template<size_t Degree>
+    constexpr double polyval(const double* coeffs, double x) {
+        return inline_::hornerStep<Degree>(coeffs, x, coeffs[Degree]);
+    }
+
+    template<size_t Degree>
+    inline void polyval(const double* coeffs, const double* x, double* out, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = polyval<Degree>(coeffs, x[i]);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include "calc/calc.h"
+
+namespace calc {
+    struct ReduceOptions {
+        // Threads to split the work across, the caller included; 0 uses one per hardware thread.
+        unsigned threads = 0;
+
+        // Split the input into fixed-size chunks whose partial results are combined in
+        // index order, so results are bitwise identical for every thread count and
+        // machine. When false each thread reduces one contiguous share and partials are
+        // combined as threads finish, which saves a little bookkeeping on small inputs.
+        bool deterministic = true;
+    };
+
+    struct Extremum {
+        double value;   // NaN when there is no non-NaN element
+        size_t index;   // position of value; n when there is no non-NaN element
+    };
+
+    // Parallel reductions. Every thread runs SIMD lanes with their own error-free
+    // accumulators (TwoSum, TwoProduct), so sum and dot are as accurate as if computed in
+    // twice the working precision and then rounded, and product carries its rounding
+    // errors the same way. The empty sum and dot are 0; the empty product is 1. An
+    // infinite input or an overflow gives +-inf (NaN for inf - inf or 0 * inf) as the
+    // plain IEEE computation would.
+    CALC_API double sum(const double* x, size_t n, const ReduceOptions& options = ReduceOptions());
+    CALC_API double dot(const double* a, const double* b, size_t n, const ReduceOptions& options = ReduceOptions());
+    CALC_API double product(const double* x, size_t n, const ReduceOptions& options = ReduceOptions());
+
+    // Smallest / largest element and its lowest index. NaNs are skipped; -0 and +0 tie.
+    CALC_API Extremum minimum(const double* x, size_t n, const ReduceOptions& options = ReduceOptions());
+    CALC_API Extremum maximum(const double* x, size_t n, const ReduceOptions& options = ReduceOptions());
+
+    inline double sum(Span<const double> x, const ReduceOptions& options = ReduceOptions()) {
+        return sum(x.data, x.size, options);
+    }
+
+    inline double dot(Span<const double> a, Span<const double> b, const ReduceOptions& options = ReduceOptions()) {
+        return dot(a.data, b.data, std::min(a.size, b.size), options);
+    }
+
+    inline double product(Span<const double> x, const ReduceOptions& options = ReduceOptions()) {
+        return product(x.data, x.size, options);
+    }
+
+    inline Extremum minimum(Span<const double> x, const ReduceOptions& options = ReduceOptions()) {
+        return minimum(x.data, x.size, options);
+    }
+
+    inline Extremum maximum(Span<const double> x, const ReduceOptions& options = ReduceOptions()) {
+        return maximum(x.data, x.size, options);
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "calc/calc.h"
+#include "calc/expression.h"
+
+namespace calc {
+    struct SheetOptions {
+        // Threads for levels with many cells to evaluate, the caller included; 0 uses
+        // one per hardware thread. The results do not depend on it.
+        unsigned threads = 0;
+    };
+
+    // Spreadsheet-style cells that recompute only what changed.
+    //
+    // A cell is either an input holding a value or a formula in Expression syntax whose
+    // variables name other cells ("total = price * quantity"). Naming a cell that does
+    // not exist yet creates it as an input holding NaN.
+    //
+    // set() and define() only record the change; recompute() then evaluates the cells
+    // downstream of everything changed since the last call, so a tick that sets many
+    // inputs pays for one pass. Cells are kept in levels (a formula sits above every
+    // cell it reads) and evaluated level by level; the cells of one level are
+    // independent and are split across threads when there are enough of them. A formula
+    // whose result is bit-for-bit unchanged does not wake its own dependents.
+    //
+    // Cell handles are small integers, stable for the life of the sheet. Not
+    // thread-safe: one thread drives the sheet, recompute() fans the work out itself.
+    class CALC_API Sheet {
+    public:
+        // Handle of the named cell, created as an input holding NaN if new.
+        int cell(const std::string& name);
+        // Handle of the named cell, or -1.
+        int find(const std::string& name) const;
+
+        // Makes name a formula cell. Returns false and fills error (when given), leaving
+        // the sheet unchanged, if formula does not parse or would make the cell depend on
+        // itself.
+        bool define(const std::string& name, const std::string& formula, std::string* error = nullptr);
+
+        // Makes the cell an input holding value (a formula cell stops being one).
+        void set(int cell, double value);
+        void set(const std::string& name, double value) { set(cell(name), value); }
+
+        // Evaluates every cell affected by set() and define() since the last call and
+        // returns how many formulas ran.
+        size_t recompute(const SheetOptions& options = SheetOptions());
+
+        // Values as of the last recompute() (inputs read back what was set). NaN for
+        // an unknown name.
+        double value(int cell) const { return values_[cell]; }
+        double value(const std::string& name) const;
+
+        size_t size() const { return names_.size(); }
+        const std::string& name(int cell) const { return names_[cell]; }
+        bool isFormula(int cell) const { return formulas_[cell].expression.valid(); }
+        const std::string& formula(int cell) const { return formulas_[cell].expression.source(); }
+
+    private:
+        struct Formula {
+            Expression expression;
+            std::vector<int> inputs;    // cell of each expression variable, in order
+        };
+
+        std::unordered_map<std::string, int> index_;
+        std::vector<std::string> names_;
+        std::vector<double> values_;
+        std::vector<Formula> formulas_;
+        std::vector<std::vector<int>> dependents_;  // formulas reading each cell
+        std::vector<uint32_t> levels_;
+        std::vector<uint8_t> queued_;               // waiting in buckets_
+        std::vector<uint8_t> changed_;              // waiting in changes_
+        std::vector<std::vector<int>> buckets_;     // formulas to evaluate, by level
+        std::vector<int> changes_;                  // cells whose dependents must run
+
+        void detach(int cell);
+        void raiseLevel(int cell, uint32_t level);
+        bool reaches(int from, const std::vector<int>& targets) const;
+        void enqueue(int cell);
+        void wakeDependents(int cell);
+    };
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "calc/calc.h"
+#include "calc/expression.h"
+
+namespace calc {
+    // f over a batch of points: out[i] = f(x[i]) for i in [0, n). Called from several
+    // threads at once when the options allow more than one.
+    using BatchFunction = std::function<void(const double* x, double* out, size_t n)>;
+
+    struct IntegrateOptions {
+        // Stops once the error estimate is within max(absoluteTolerance,
+        // relativeTolerance * |value|).
+        double absoluteTolerance = 1e-10;
+        double relativeTolerance = 1e-10;
+        size_t maxIntervals = 10000;
+        // Threads evaluating subintervals, the caller included; 0 uses one per hardware
+        // thread. The results do not depend on it.
+        unsigned threads = 0;
+    };
+
+    struct IntegrateResult {
+        double value;
+        double error;           // estimated absolute error
+        size_t evaluations;     // points at which f was evaluated
+        size_t intervals;       // subintervals in the final partition
+        bool converged;         // false when maxIntervals ran out first
+    };
+
+    // Adaptive Gauss-Kronrod quadrature of f over [a, b] (finite bounds; a > b gives the
+    // negated integral). Each subinterval gets the 21-point Kronrod rule with its embedded
+    // 10-point Gauss rule, and the error estimate is QUADPACK's. Every round bisects up to
+    // 32 subintervals with the largest errors and evaluates the 21 nodes of all their
+    // halves as batches of 8 subintervals, split across threads.
+    CALC_API IntegrateResult integrate(const BatchFunction& f, double a, double b, const IntegrateOptions& options = IntegrateOptions());
+    CALC_API IntegrateResult integrate(const std::function<double(double)>& f, double a, double b, const IntegrateOptions& options = IntegrateOptions());
+    // For an expression of at most one variable, evaluated with the batch kernels. Returns
+    // false and fills error (when given) if it has more.
+    CALC_API bool integrate(const Expression& expression, double a, double b, IntegrateResult& result,
+                            const IntegrateOptions& options = IntegrateOptions(), std::string* error = nullptr);
+
+    struct RootOptions {
+        double tolerance = 1e-12;       // absolute, on x
+        size_t maxIterations = 200;
+        // Threads for findRoots, the caller included; 0 uses one per hardware thread.
+        unsigned threads = 0;
+    };
+
+    struct RootResult {
+        double root;            // NaN when [a, b] does not bracket a root
+        double value;           // f(root)
+        size_t iterations;
+        bool converged;
+    };
+
+    // Brent's method on a bracket: f(a) and f(b) must differ in sign (or one be zero).
+    // Combines inverse quadratic interpolation and the secant step with bisection, so it
+    // converges superlinearly on smooth functions and never slower than bisection.
+    CALC_API RootResult findRoot(const std::function<double(double)>& f, double a, double b, const RootOptions& options = RootOptions());
+    // For an expression of exactly one variable. Returns false and fills error (when
+    // given) if it has another number of variables.
+    CALC_API bool findRoot(const Expression& expression, double a, double b, RootResult& result,
+                           const RootOptions& options = RootOptions(), std::string* error = nullptr);
+
+    // Every root that shows up as a sign change between samples + 1 evenly spaced points
+    // of [a, b]: the grid is evaluated in one batch, then the brackets are refined with
+    // Brent's method in parallel. Roots come back in increasing order.
+    CALC_API std::vector<RootResult> findRoots(const BatchFunction& f, double a, double b, size_t samples,
+                                               const RootOptions& options = RootOptions());
+}
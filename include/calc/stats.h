@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "calc/calc.h"
+
+namespace calc {
+    // Streaming mean, variance, skewness, kurtosis, min and max.
+    //
+    // Samples are folded in one at a time (Welford's update extended to the third and
+    // fourth central moments) or a block at a time, and two accumulators merge exactly
+    // as if one had seen both streams (Pebay's pairwise formulas), so threads can each
+    // keep their own and combine them at the end. NaN samples are skipped and counted
+    // separately. Not thread-safe.
+    class CALC_API Moments {
+    public:
+        Moments();
+
+        void add(double x);
+        // One chunk of a stream; call repeatedly to feed data without materializing it.
+        void add(const double* x, size_t n);
+        void add(Span<const double> x) { add(x.data, x.size); }
+        void merge(const Moments& other);
+
+        uint64_t count() const { return count_; }
+        uint64_t nanCount() const { return nanCount_; }
+        double mean() const;                // NaN when empty
+        double variance() const;            // population variance, M2 / n
+        double sampleVariance() const;      // unbiased, M2 / (n - 1); NaN below two samples
+        double standardDeviation() const;   // sqrt(variance())
+        double skewness() const;            // population skewness
+        double kurtosis() const;            // population excess kurtosis
+        double min() const { return min_; } // NaN when empty
+        double max() const { return max_; }
+
+    private:
+        uint64_t count_;
+        uint64_t nanCount_;
+        double mean_;
+        double m2_, m3_, m4_;   // sums of the 2nd..4th powers of deviations from the mean
+        double min_, max_;
+    };
+
+    // Mergeable quantile sketch with relative-error guarantees (DDSketch).
+    //
+    // Values are counted in logarithmic buckets of ratio (1 + a) / (1 - a), so any
+    // quantile is returned within a relative error a of a sample of the right rank.
+    // Memory stays bounded: past maxBuckets per sign the buckets nearest zero are merged,
+    // which only coarsens the smallest magnitudes. Zero (and magnitudes below 1e-300) has
+    // its own count; NaN and infinite samples are ignored. Sketches merge exactly when
+    // built with the same accuracy. Not thread-safe.
+    class CALC_API QuantileSketch {
+    public:
+        explicit QuantileSketch(double relativeAccuracy = 0.01, size_t maxBuckets = 2048);
+
+        void add(double x);
+        void add(const double* x, size_t n);
+        void add(Span<const double> x) { add(x.data, x.size); }
+        // Returns false, leaving this sketch unchanged, when the accuracies differ.
+        bool merge(const QuantileSketch& other);
+
+        uint64_t count() const { return count_; }
+        double relativeAccuracy() const { return accuracy_; }
+        // q in [0, 1]; q = 0 and q = 1 give the exact min and max. NaN when empty.
+        double quantile(double q) const;
+
+    private:
+        // Dense counts for bucket keys offset_ .. offset_ + counts.size() - 1
+        struct Store {
+            std::vector<uint64_t> counts;
+            int32_t offset = 0;
+
+            void add(int32_t key, uint64_t n, size_t maxBuckets);
+            void merge(const Store& other, size_t maxBuckets);
+        };
+
+        int32_t key(double magnitude) const;
+        double value(int32_t key) const;
+
+        double accuracy_;
+        double gamma_;
+        double multiplier_;     // 1 / log(gamma)
+        size_t maxBuckets_;
+        Store positive_;
+        Store negative_;        // keyed by magnitude
+        uint64_t zeros_;
+        uint64_t count_;
+        double min_, max_;
+    };
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "calc/calc.h"
+
+// Tracing has three modes:
+//   CALC_TRACE_MODE=0  trace points compile to nothing
+//   CALC_TRACE_MODE=1  trace points cost one predictable branch until enabled at runtime
+//                      (calc::trace::enable or CALC_TRACE=1 in the environment); once
+//                      enabled, records go to a lock-free per-thread ring buffer that a
+//                      background writer drains into the installed sink
+#ifndef CALC_TRACE_MODE
+    #define CALC_TRACE_MODE 1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define CALC_TRACE_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+    #define CALC_TRACE_UNLIKELY(x) (x)
+#endif
+
+namespace calc {
+namespace trace {
+    enum class Event : uint8_t {
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Power,
+        SquareRoot,
+        Sum,
+        Dot,
+        Product,
+        Minimum,
+        Maximum,
+        MatrixMultiply,  // count is the number of multiply-adds
+        DivideByZero,
+        NegativeSquareRoot,
+        Call  // Caller-defined call, named by Record::name
+    };
+
+    struct Record {
+        uint64_t nanos;      // steady clock timestamp
+        uint32_t thread;     // small per-process thread id, in order of first trace
+        Event event;
+        uint8_t arity;       // number of meaningful operands in a/b
+        const char* name;    // static string for Event::Call, nullptr otherwise
+        size_t count;        // element count for batch operations, 0 for scalar calls
+        double a, b;
+    };
+
+    // Sinks run on the writer thread, never on the traced thread.
+    using Sink = void (*)(const Record& record, void* user);
+
+    CALC_API extern std::atomic<bool> enabledFlag;
+
+    inline bool enabled() {
+        return enabledFlag.load(std::memory_order_relaxed);
+    }
+
+    CALC_API void enable(bool on);
+    // Installs a sink; nullptr restores the default one that prints to stdout.
+    CALC_API void setSink(Sink sink, void* user = nullptr);
+    // Blocks until every record traced before the call has reached the sink.
+    CALC_API void flush();
+    // Records dropped because a thread's ring buffer was full.
+    CALC_API uint64_t dropped();
+    // Formats a record the way the default sink prints it; returns the length written.
+    CALC_API size_t format(const Record& record, char* buffer, size_t size);
+
+    CALC_API void record(Event event, size_t count, uint8_t arity, double a, double b, const char* name = nullptr);
+}
+}
+
+#if CALC_TRACE_MODE
+    #define CALC_TRACE_IMPL(event, count, arity, a, b, name) \
+        do { \
+            if (CALC_TRACE_UNLIKELY(calc::trace::enabled())) { \
+                calc::trace::record((event), (count), (arity), (a), (b), (name)); \
+            } \
+        } while (0)
+#else
+    #define CALC_TRACE_IMPL(event, count, arity, a, b, name) ((void)0)
+#endif
+
+#define CALC_TRACE_OP(event, a, b) CALC_TRACE_IMPL(calc::trace::Event::event, 0, 2, a, b, nullptr)
+#define CALC_TRACE_OP1(event, a) CALC_TRACE_IMPL(calc::trace::Event::event, 0, 1, a, 0.0, nullptr)
+#define CALC_TRACE_BATCH(event, n) CALC_TRACE_IMPL(calc::trace::Event::event, n, 0, 0.0, 0.0, nullptr)
+#define CALC_TRACE_ERROR(event) CALC_TRACE_IMPL(calc::trace::Event::event, 0, 0, 0.0, 0.0, nullptr)
+#define CALC_TRACE_CALL(name, a, b) CALC_TRACE_IMPL(calc::trace::Event::Call, 0, 2, a, b, name)
+#define CALC_TRACE_CALL1(name, a) CALC_TRACE_IMPL(calc::trace::Event::Call, 0, 1, a, 0.0, name)
@@ -5,6 +5,7 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 #ifdef _WIN32
     #ifdef GRAPHICS_BUILDING_DLL
@@ -32,6 +33,65 @@ namespace graphics {
     class ShapeManager;
     class EventHandler;
 
+    // Direct pixel access to a surface for one frame of drawing. The constructor locks
+    // the surface (when it needs locking) and the destructor unlocks it, so a frame pays
+    // for one lock rather than an SDL call per pixel. Colors are pixel values in the
+    // surface's format, as SDL_FillSurfaceRect takes them, and everything is clipped to
+    // the clip rectangle, which starts as the surface's own. 32-bit formats (ARGB8888,
+    // XRGB8888 and the other 4-byte layouts) are written a word at a time; 8, 16 and
+    // 24-bit formats take a generic path.
+    class GRAPHICS_API Canvas {
+    public:
+        explicit Canvas(SDL_Surface* surface);
+        // The pixels of parent, clipped to rect within its clip rectangle, without locking
+        // again: lets threads draw disjoint parts of one frame. parent must outlive it.
+        Canvas(Canvas& parent, const SDL_Rect& rect);
+        ~Canvas();
+        Canvas(const Canvas&) = delete;
+        Canvas& operator=(const Canvas&) = delete;
+
+        // False when the surface is null, has no addressable pixels or failed to lock;
+        // drawing is then a no-op.
+        bool isValid() const { return pixels_ != nullptr; }
+        SDL_Surface* getSurface() const { return surface_; }
+        int getWidth() const { return width_; }
+        int getHeight() const { return height_; }
+
+        // Restricts drawing to rect, intersected with the surface; null restores the
+        // whole surface.
+        void setClip(const SDL_Rect* rect);
+        const SDL_Rect& getClip() const { return clip_; }
+
+        void setPixel(int x, int y, Uint32 color) {
+            if (x < clip_.x || y < clip_.y || x >= clip_.x + clip_.w || y >= clip_.y + clip_.h) return;
+            Uint8* pixel = pixels_ + (size_t)y * pitch_ + (size_t)x * bytesPerPixel_;
+            if (bytesPerPixel_ == 4) {
+                *(Uint32*)pixel = color;
+            } else {
+                writePixel(pixel, color);
+            }
+        }
+        // Fills pixels x0 to x1 - 1 of row y.
+        void fillSpan(int y, int x0, int x1, Uint32 color);
+        void fillRect(const SDL_Rect& rect, Uint32 color);
+        void clear(Uint32 color) { fillRect(clip_, color); }
+        // Copies a width x height block of pixels already in the surface's format, whose
+        // rows start pitch bytes apart, with its top left corner at (x, y).
+        void blit(const void* pixels, int pitch, int width, int height, int x, int y);
+
+    private:
+        SDL_Surface* surface_;
+        Uint8* pixels_;
+        int pitch_;
+        int bytesPerPixel_;
+        int width_, height_;
+        SDL_Rect clip_;
+        bool locked_;
+
+        void writePixel(Uint8* pixel, Uint32 color) const;
+        void writeRun(Uint8* start, int count, Uint32 color) const;
+    };
+
     // Event types
     enum class MouseEventType {
         CLICK,
@@ -68,6 +128,14 @@ namespace graphics {
         ActionCallback onHoverAction = nullptr;
     };
 
+    // Options for ShapeManager::drawAll's tiled, parallel path
+    struct DrawOptions {
+        // Threads rendering tiles, the caller included; 0 uses one per hardware thread
+        unsigned threads = 0;
+        // Edge of the square tiles, in pixels
+        int tileSize = 64;
+    };
+
     // Abstract base class for all shapes
     class GRAPHICS_API Shape {
     public:
@@ -75,10 +143,15 @@ namespace graphics {
         virtual ~Shape() = default;
 
         // Pure virtual methods
-        virtual void draw(SDL_Surface* surface) = 0;
+        virtual void draw(Canvas& canvas) = 0;
         virtual bool contains(double x, double y) const = 0;
         virtual Shape* clone() const = 0;
         virtual std::string getType() const = 0;
+        // Pixels draw() can touch; empty while invisible
+        virtual SDL_Rect getBounds() const = 0;
+
+        // Locks surface for this one shape; a frame of many shapes should share a Canvas
+        void draw(SDL_Surface* surface);
 
         // Virtual drawShape method that calls draw() - can be overridden for specific behavior
         virtual void drawShape(SDL_Surface* surface);
@@ -100,14 +173,19 @@ namespace graphics {
         int getZOrder() const { return zOrder_; }
         
         // Setters
-        void setColor(Uint32 color) { color_ = color; }
+        void setColor(Uint32 color) { color_ = color; dirty_ = true; }
         void setColorHighlight(Uint32 color);
-        void setSelected(bool selected) { isSelected_ = selected; }
-        void setVisible(bool visible) { visible_ = visible; }
+        void setSelected(bool selected) { isSelected_ = selected; dirty_ = true; }
+        void setVisible(bool visible) { visible_ = visible; dirty_ = true; }
         void setSelectable(bool selectable) { selectable_ = selectable; }
         void setDraggable(bool draggable) { draggable_ = draggable; }
         void setClickable(bool clickable) { clickable_ = clickable; }
-        void setZOrder(int zOrder) { zOrder_ = zOrder; }
+        void setZOrder(int zOrder) { zOrder_ = zOrder; dirty_ = true; }
+
+        // Set by every change to how the shape looks; ShapeManager clears it once it
+        // has recorded the damage
+        bool isDirty() const { return dirty_; }
+        void setDirty(bool dirty) { dirty_ = dirty; }
 
         // Event action setters
         void setClickAction(ActionCallback action) { onClickAction_ = action; }
@@ -135,6 +213,7 @@ namespace graphics {
         bool clickable_;
         int zOrder_;
         bool isDragging_;
+        bool dirty_;
 
         // Action callbacks
         ActionCallback onClickAction_;
@@ -148,14 +227,16 @@ namespace graphics {
     public:
         Circle(double x, double y, double radius, Uint32 color, const ShapeOptions& options = ShapeOptions{});
         
-        void draw(SDL_Surface* surface) override;
+        using Shape::draw;
+        void draw(Canvas& canvas) override;
         void drawShape(SDL_Surface* surface) override;
         bool contains(double x, double y) const override;
         Shape* clone() const override;
         std::string getType() const override { return "Circle"; }
+        SDL_Rect getBounds() const override;
         
         double getRadius() const { return radius_; }
-        void setRadius(double radius) { radius_ = radius; }
+        void setRadius(double radius) { radius_ = radius; dirty_ = true; }
 
     private:
         double radius_;
@@ -166,16 +247,18 @@ namespace graphics {
     public:
         Rectangle(double x, double y, double width, double height, Uint32 color, const ShapeOptions& options = ShapeOptions{});
         
-        void draw(SDL_Surface* surface) override;
+        using Shape::draw;
+        void draw(Canvas& canvas) override;
         void drawShape(SDL_Surface* surface) override;
         bool contains(double x, double y) const override;
         Shape* clone() const override;
         std::string getType() const override { return "Rectangle"; }
+        SDL_Rect getBounds() const override;
         
         double getWidth() const { return width_; }
         double getHeight() const { return height_; }
-        void setWidth(double width) { width_ = width; }
-        void setHeight(double height) { height_ = height; }
+        void setWidth(double width) { width_ = width; dirty_ = true; }
+        void setHeight(double height) { height_ = height; dirty_ = true; }
 
     private:
         double width_, height_;
@@ -186,11 +269,13 @@ namespace graphics {
     public:
         Triangle(double x1, double y1, double x2, double y2, double x3, double y3, Uint32 color, const ShapeOptions& options = ShapeOptions{});
         
-        void draw(SDL_Surface* surface) override;
+        using Shape::draw;
+        void draw(Canvas& canvas) override;
         void drawShape(SDL_Surface* surface) override;
         bool contains(double x, double y) const override;
         Shape* clone() const override;
         std::string getType() const override { return "Triangle"; }
+        SDL_Rect getBounds() const override;
         
         void setPosition(double x, double y) override;
         void move(double deltaX, double deltaY) override;
@@ -265,14 +350,32 @@ namespace graphics {
         void deselectAll();
         void selectAll();
 
-        // Rendering
+        // Rendering. Shapes outside the canvas clip rectangle are skipped.
         void drawAll(SDL_Surface* surface);
+        void drawAll(Canvas& canvas);
+        // Same pixels, rendered in parallel: the clip rectangle is cut into tiles, each
+        // shape is binned into the tiles its bounds overlap, and the tiles are drawn on a
+        // worker pool, each in z-order through a Canvas clipped to it. A shape's draw()
+        // therefore runs once per tile it overlaps, possibly on several threads at once,
+        // and must only read the shape. Small scenes are drawn serially.
+        void drawAll(Canvas& canvas, const DrawOptions& options);
+
+        // Damage tracking. takeDamage() returns what must be redrawn since its last
+        // call: the bounds each changed, added or removed shape had then and has now,
+        // plus the regions passed to invalidate(), merged with mergeRects() and clipped
+        // to bounds. All of bounds is damaged on the first call, when bounds changes and
+        // after invalidateAll(). Clearing the returned regions and drawing into each
+        // with it as the clip rectangle brings the surface up to date.
+        void invalidate(const SDL_Rect& rect);
+        void invalidateAll();
+        std::vector<SDL_Rect> takeDamage(const SDL_Rect& bounds);
 
         // Access
         const std::vector<std::shared_ptr<Shape>>& getShapes() const { return shapes_; }
         size_t getShapeCount() const { return shapes_.size(); }
 
-        // Z-order management
+        // Z-order management. Shapes with equal z-order keep the order they were added
+        // in, so reordering never moves unchanged shapes relative to each other.
         void bringToFront(std::shared_ptr<Shape> shape);
         void sendToBack(std::shared_ptr<Shape> shape);
         void moveUp(std::shared_ptr<Shape> shape);
@@ -280,11 +383,45 @@ namespace graphics {
 
     private:
         std::vector<std::shared_ptr<Shape>> shapes_;
+        std::unordered_map<const Shape*, SDL_Rect> drawnBounds_;   // as of the last takeDamage()
+        std::vector<SDL_Rect> damage_;
+        SDL_Rect damageBounds_;
+        bool damageAll_;
         void sortByZOrder();
+        void forget(const std::shared_ptr<Shape>& shape);
     };
 
+    // Filled circle rasterized a scanline at a time: the pixels whose offset (dx, dy)
+    // from the rounded center has dx^2 + dy^2 <= radius^2 + radius, the midpoint-circle
+    // boundary, drawn as one span per row.
+    GRAPHICS_API void fillCircle(Canvas& canvas, double x, double y, double radius, Uint32 color);
+
+    // Filled triangle from edge functions set up once and stepped across 8x8 blocks:
+    // blocks outside an edge are skipped, blocks inside all three are filled whole, and
+    // the rest are evaluated several pixels at a time. Vertices snap to 1/16 pixel and
+    // pixels are sampled at their centers, with the top-left rule for centers exactly
+    // on an edge, so triangles sharing an edge neither overlap nor leave a gap there.
+    GRAPHICS_API void fillTriangle(Canvas& canvas, double x1, double y1, double x2, double y2, double x3, double y3, Uint32 color);
+    // count triangles of a mesh: points holds x, y pairs and indices three points per
+    // triangle, or null for consecutive triples.
+    GRAPHICS_API void fillTriangles(Canvas& canvas, const double* points, const uint32_t* indices, size_t count, Uint32 color);
+
+    // Merges rectangles while drawing their union costs less than drawing them apart,
+    // allowing for a fixed cost per rectangle, so the result is a few rectangles that
+    // cover at least the same pixels. Empty rectangles are dropped.
+    GRAPHICS_API void mergeRects(std::vector<SDL_Rect>& rects);
+
     // Utility functions for ray casting (for compatibility with existing code)
     GRAPHICS_API void generateRays(Circle sun, struct Ray rays[RAY_COUNT]);
+    GRAPHICS_API void drawRays(Canvas& canvas, Circle sun, struct Ray rays[RAY_COUNT], Uint32 color, Circle planets[PLANET_COUNT]);
     GRAPHICS_API void drawRays(SDL_Surface* surface, Circle sun, struct Ray rays[RAY_COUNT], Uint32 color, Circle planets[PLANET_COUNT]);
+    // drawRays in two halves: traceRays counts the one-pixel steps each ray takes until it
+    // leaves a width x height window or enters a planet, and the second drawRays draws
+    // that many, skipping rays that miss the clip rectangle. Comparing lengths between
+    // frames tells which rays changed.
+    GRAPHICS_API void traceRays(struct Ray rays[RAY_COUNT], Circle planets[PLANET_COUNT], int width, int height, int lengths[RAY_COUNT]);
+    GRAPHICS_API void drawRays(Canvas& canvas, struct Ray rays[RAY_COUNT], const int lengths[RAY_COUNT], Uint32 color);
+    // Pixels ray draws from step from + 1 to step to, with a pixel to spare around them.
+    GRAPHICS_API SDL_Rect rayBounds(const struct Ray& ray, int from, int to);
 
 } // namespace graphics
\ No newline at end of file
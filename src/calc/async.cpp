@@ -0,0 +1,376 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "calc/async.h"
+#include "pool.h"
+
+namespace calc {
+namespace async {
+    namespace detail {
+        // A job runs as pieces: [begin, end) ranges of its elements. The first piece
+        // covers everything and is halved by whichever worker picks it up, the halves
+        // going on that worker's queue where idle workers can steal them.
+        struct JobState {
+            std::function<void(size_t, size_t)> body;
+            size_t grain = 1;           // pieces are split down to this many elements
+            Priority priority = Priority::Normal;
+            std::function<void(Status)> onComplete;
+            std::string error;
+
+            std::atomic<int> status{(int)Status::Pending};
+            std::atomic<bool> stop{false};
+            std::atomic<size_t> pieces{1};  // queued or running
+            std::atomic<bool> finished{false};
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+    }
+
+    namespace {
+        using detail::JobState;
+
+        // Elements per piece of a batch job: long enough to amortize queueing, short
+        // enough that higher priority work and cancellation are seen within tens of
+        // microseconds.
+        const size_t GRAIN = (size_t)1 << 15;
+        const int PRIORITIES = 3;
+
+        struct Piece {
+            std::shared_ptr<JobState> job;
+            size_t begin;
+            size_t end;
+        };
+
+        thread_local int workerIndex = -1;
+        thread_local JobState* currentJob = nullptr;
+
+        void finish(JobState& job, Status status) {
+            job.status.store((int)status);
+            if (job.onComplete) {
+                job.onComplete(status);
+            }
+            {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                job.finished.store(true);
+            }
+            job.done.notify_all();
+        }
+
+        class Scheduler {
+        public:
+            explicit Scheduler(unsigned threads) {
+                for (unsigned i = 0; i < threads; i++) {
+                    workers_.emplace_back(new Worker());
+                }
+                for (unsigned i = 0; i < threads; i++) {
+                    threads_.emplace_back([this, i] { work((int)i); });
+                }
+            }
+
+            ~Scheduler() {
+                {
+                    std::lock_guard<std::mutex> lock(sleepMutex_);
+                    stopping_ = true;
+                }
+                wake_.notify_all();
+                for (std::thread& thread : threads_) {
+                    thread.join();
+                }
+            }
+
+            // From outside the pool: a shared queue that every worker checks.
+            void inject(Piece piece) {
+                int priority = (int)piece.job->priority;
+                // Counted before it is visible, so a taker never drives the count below zero
+                queued_.fetch_add(1);
+                {
+                    std::lock_guard<std::mutex> lock(injectedMutex_);
+                    injected_[priority].push_back(std::move(piece));
+                }
+                wakeOne();
+            }
+
+            // Runs one queued piece on the calling worker; false when none was found.
+            bool runOne(int self) {
+                Piece piece;
+                if (!take(self, piece)) {
+                    return false;
+                }
+                execute(self, piece);
+                return true;
+            }
+
+        private:
+            struct Worker {
+                std::mutex mutex;
+                std::deque<Piece> queues[PRIORITIES];
+            };
+
+            std::vector<std::unique_ptr<Worker>> workers_;
+            std::vector<std::thread> threads_;
+            std::mutex injectedMutex_;
+            std::deque<Piece> injected_[PRIORITIES];
+            std::atomic<size_t> queued_{0};
+            std::mutex sleepMutex_;
+            std::condition_variable wake_;
+            unsigned sleeping_ = 0;
+            bool stopping_ = false;
+
+            void push(int self, Piece piece) {
+                int priority = (int)piece.job->priority;
+                queued_.fetch_add(1);
+                {
+                    std::lock_guard<std::mutex> lock(workers_[self]->mutex);
+                    workers_[self]->queues[priority].push_back(std::move(piece));
+                }
+                wakeOne();
+            }
+
+            void wakeOne() {
+                std::lock_guard<std::mutex> lock(sleepMutex_);
+                if (sleeping_ > 0) {
+                    wake_.notify_one();
+                }
+            }
+
+            // Highest priority first; within a priority the worker's own newest piece
+            // (still warm in its cache), then injected work, then the oldest (largest)
+            // piece of another worker.
+            bool take(int self, Piece& piece) {
+                size_t count = workers_.size();
+                for (int priority = PRIORITIES - 1; priority >= 0; priority--) {
+                    {
+                        std::lock_guard<std::mutex> lock(workers_[self]->mutex);
+                        std::deque<Piece>& own = workers_[self]->queues[priority];
+                        if (!own.empty()) {
+                            piece = std::move(own.back());
+                            own.pop_back();
+                            queued_.fetch_sub(1);
+                            return true;
+                        }
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(injectedMutex_);
+                        std::deque<Piece>& shared = injected_[priority];
+                        if (!shared.empty()) {
+                            piece = std::move(shared.front());
+                            shared.pop_front();
+                            queued_.fetch_sub(1);
+                            return true;
+                        }
+                    }
+                    for (size_t k = 1; k < count; k++) {
+                        Worker& victim = *workers_[(self + k) % count];
+                        std::lock_guard<std::mutex> lock(victim.mutex);
+                        std::deque<Piece>& theirs = victim.queues[priority];
+                        if (!theirs.empty()) {
+                            piece = std::move(theirs.front());
+                            theirs.pop_front();
+                            queued_.fetch_sub(1);
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            }
+
+            void execute(int self, Piece& piece) {
+                JobState& job = *piece.job;
+                int pending = (int)Status::Pending;
+                job.status.compare_exchange_strong(pending, (int)Status::Running);
+                if (job.status.load() != (int)Status::Running) {
+                    // Cancelled before it started; cancel() already finished it
+                    job.pieces.fetch_sub(1);
+                    return;
+                }
+                while (piece.end - piece.begin > job.grain && !job.stop.load(std::memory_order_relaxed)) {
+                    size_t half = (piece.end - piece.begin) / 2;
+                    size_t middle = piece.begin + (half + job.grain - 1) / job.grain * job.grain;
+                    job.pieces.fetch_add(1);
+                    push(self, Piece{piece.job, middle, piece.end});
+                    piece.end = middle;
+                }
+                if (!job.stop.load(std::memory_order_relaxed)) {
+                    JobState* outer = currentJob;
+                    currentJob = &job;
+                    job.body(piece.begin, piece.end);
+                    currentJob = outer;
+                }
+                if (job.pieces.fetch_sub(1) == 1) {
+                    finish(job, job.stop.load() ? Status::Cancelled : Status::Completed);
+                }
+            }
+
+            void work(int self) {
+                workerIndex = self;
+                for (;;) {
+                    Piece piece;
+                    if (take(self, piece)) {
+                        execute(self, piece);
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> lock(sleepMutex_);
+                    sleeping_++;
+                    wake_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+                    sleeping_--;
+                    if (stopping_) {
+                        return;
+                    }
+                }
+            }
+        };
+
+        Scheduler& scheduler() {
+            static Scheduler instance(pool::hardwareThreads());
+            return instance;
+        }
+
+        Job start(std::function<void(size_t, size_t)> body, size_t count, size_t grain, const Options& options) {
+            std::shared_ptr<JobState> state = std::make_shared<JobState>();
+            state->body = std::move(body);
+            state->grain = grain;
+            state->priority = options.priority;
+            state->onComplete = options.onComplete;
+            scheduler().inject(Piece{state, 0, count});
+            return Job(state);
+        }
+
+        Job failed(const std::string& error, const Options& options) {
+            std::shared_ptr<JobState> state = std::make_shared<JobState>();
+            state->error = error;
+            state->onComplete = options.onComplete;
+            state->pieces.store(0);
+            finish(*state, Status::Failed);
+            return Job(state);
+        }
+
+        using Binary = void (*)(const double*, const double*, double*, size_t);
+
+        Job batch(Binary operation, const double* a, const double* b, double* out, size_t n, const Options& options) {
+            return start([operation, a, b, out](size_t begin, size_t end) {
+                operation(a + begin, b + begin, out + begin, end - begin);
+            }, n, GRAIN, options);
+        }
+    }
+
+    Status Job::status() const {
+        return state_ ? (Status)state_->status.load() : Status::Failed;
+    }
+
+    bool Job::done() const {
+        return !state_ || state_->finished.load();
+    }
+
+    Status Job::wait() const {
+        if (!state_) {
+            return Status::Failed;
+        }
+        if (workerIndex >= 0) {
+            // Sleeping here could leave every worker waiting on pieces nobody runs
+            while (!state_->finished.load()) {
+                if (!scheduler().runOne(workerIndex)) {
+                    std::this_thread::yield();
+                }
+            }
+        } else {
+            std::unique_lock<std::mutex> lock(state_->mutex);
+            state_->done.wait(lock, [this] { return state_->finished.load(); });
+        }
+        return status();
+    }
+
+    bool Job::waitFor(std::chrono::milliseconds timeout) const {
+        if (!state_) {
+            return true;
+        }
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        return state_->done.wait_for(lock, timeout, [this] { return state_->finished.load(); });
+    }
+
+    bool Job::cancel() {
+        if (!state_ || state_->finished.load()) {
+            return false;
+        }
+        state_->stop.store(true);
+        int pending = (int)Status::Pending;
+        if (state_->status.compare_exchange_strong(pending, (int)Status::Cancelled)) {
+            // Its queued piece is discarded when a worker reaches it
+            finish(*state_, Status::Cancelled);
+        }
+        return true;
+    }
+
+    const std::string& Job::error() const {
+        static const std::string none;
+        return state_ ? state_->error : none;
+    }
+
+    Job submit(std::function<void()> task, const Options& options) {
+        return start([task](size_t, size_t) { task(); }, 1, 1, options);
+    }
+
+    bool cancelRequested() {
+        return currentJob && currentJob->stop.load(std::memory_order_relaxed);
+    }
+
+    Job add(const double* a, const double* b, double* out, size_t n, const Options& options) {
+        return batch([](const double* x, const double* y, double* z, size_t m) { calc::add(x, y, z, m); }, a, b, out, n, options);
+    }
+
+    Job subtract(const double* a, const double* b, double* out, size_t n, const Options& options) {
+        return batch([](const double* x, const double* y, double* z, size_t m) { calc::subtract(x, y, z, m); }, a, b, out, n, options);
+    }
+
+    Job multiply(const double* a, const double* b, double* out, size_t n, const Options& options) {
+        return batch([](const double* x, const double* y, double* z, size_t m) { calc::multiply(x, y, z, m); }, a, b, out, n, options);
+    }
+
+    Job divide(const double* a, const double* b, double* out, size_t n, const Options& options) {
+        return batch([](const double* x, const double* y, double* z, size_t m) { calc::divide(x, y, z, m); }, a, b, out, n, options);
+    }
+
+    Job power(const double* base, const double* exponent, double* out, size_t n, const Options& options) {
+        return batch([](const double* x, const double* y, double* z, size_t m) { calc::power(x, y, z, m); }, base, exponent, out, n, options);
+    }
+
+    Job squareRoot(const double* values, double* out, size_t n, const Options& options) {
+        return start([values, out](size_t begin, size_t end) {
+            calc::squareRoot(values + begin, out + begin, end - begin);
+        }, n, GRAIN, options);
+    }
+
+    Job evaluate(const Expression& expression, std::vector<const double*> columns, double* out, size_t n, const Options& options) {
+        if (!expression.valid()) {
+            return failed("the expression is not compiled", options);
+        }
+        if (columns.size() != expression.variables().size()) {
+            return failed("expected " + std::to_string(expression.variables().size()) + " columns, got " + std::to_string(columns.size()), options);
+        }
+        return start([expression, columns, out](size_t begin, size_t end) {
+            std::vector<const double*> offset(columns.size());
+            for (size_t v = 0; v < columns.size(); v++) {
+                offset[v] = columns[v] + begin;
+            }
+            expression.evaluate(offset.data(), out + begin, end - begin);
+        }, n, GRAIN, options);
+    }
+
+    Future<std::vector<double>> evaluate(const Expression& expression, std::vector<const double*> columns, size_t n, const Options& options) {
+        std::shared_ptr<std::vector<double>> values = std::make_shared<std::vector<double>>();
+        if (expression.valid() && columns.size() == expression.variables().size()) {
+            values->resize(n);
+        }
+        // The job holds the vector too, so it outlives every handle
+        Options keep = options;
+        keep.onComplete = [values, onComplete = options.onComplete](Status status) {
+            if (onComplete) {
+                onComplete(status);
+            }
+        };
+        Job job = evaluate(expression, std::move(columns), values->data(), n, keep);
+        return Future<std::vector<double>>(std::move(job), std::move(values));
+    }
+}
+}
@@ -1,47 +1,222 @@
 #include <stdio.h>
 #include <math.h>
+#include <algorithm>
 #include "calc/calc.h"
+#include "calc/calc_inline.h"
+#include "calc/trace.h"
+#include "element.h"
+#include "kernel_table.h"
 
 namespace calc {
+    static thread_local uint32_t stickyErrors = status::Ok;
+
     double add(double a, double b) {
-        printf("calc::Adding %f and %f\n", a, b);
-        return a + b;
+        CALC_TRACE_OP(Add, a, b);
+        return inline_::add(a, b);
     }
 
     double subtract(double a, double b) {
-        printf("calc::Subtracting %f from %f\n", b, a);
-        return a - b;
+        CALC_TRACE_OP(Subtract, a, b);
+        return inline_::subtract(a, b);
     }
 
     double multiply(double a, double b) {
-        printf("calc::Multiplying %f and %f\n", a, b);
-        return a * b;
+        CALC_TRACE_OP(Multiply, a, b);
+        return inline_::multiply(a, b);
     }
 
     double divide(double a, double b) {
-        printf("calc::Dividing %f by %f\n", a, b);
+        CALC_TRACE_OP(Divide, a, b);
         if (b == 0) {
-            printf("Error: Division by zero is not allowed.\n");
-            return 0; // or NAN
+            stickyErrors |= status::DivideByZero;
+            CALC_TRACE_ERROR(DivideByZero);
         }
-        return a / b;
+        return inline_::divide(a, b);
     }
 
     double power(double base, double exponent) {
-        printf("calc::Calculating %f raised to the power of %f\n", base, exponent);
-        return pow(base, exponent);
+        CALC_TRACE_OP(Power, base, exponent);
+        return inline_::power(base, exponent);
     }
 
     double squareRoot(double value) {
-        printf("calc::Calculating square root of %f\n", value);
+        CALC_TRACE_OP1(SquareRoot, value);
         if (value < 0) {
-            printf("Error: Square root of negative number is not allowed.\n");
-            return 0; // or NAN
+            stickyErrors |= status::NegativeSquareRoot;
+            CALC_TRACE_ERROR(NegativeSquareRoot);
+        }
+        return inline_::squareRoot(value);
+    }
+
+    //=============================================================================
+    // Batch operations
+    //=============================================================================
+
+    void add(const double* a, const double* b, double* out, size_t n) {
+        add<double>(a, b, out, n);
+    }
+
+    void subtract(const double* a, const double* b, double* out, size_t n) {
+        subtract<double>(a, b, out, n);
+    }
+
+    void multiply(const double* a, const double* b, double* out, size_t n) {
+        multiply<double>(a, b, out, n);
+    }
+
+    void divide(const double* a, const double* b, double* out, size_t n) {
+        divide<double>(a, b, out, n);
+    }
+
+    void power(const double* base, const double* exponent, double* out, size_t n) {
+        power<double>(base, exponent, out, n);
+    }
+
+    void squareRoot(const double* values, double* out, size_t n) {
+        squareRoot<double>(values, out, n);
+    }
+
+    //=============================================================================
+    // Element-type templates
+    //=============================================================================
+    // Per-element rules are in element.h; the batch loops live in kernels_impl.h,
+    // built once per instruction set.
+
+    template<typename T>
+    T add(detail::NonDeduced<T> a, detail::NonDeduced<T> b) {
+        CALC_TRACE_OP(Add, (double)a, (double)b);
+        return element::add(a, b);
+    }
+
+    template<typename T>
+    T subtract(detail::NonDeduced<T> a, detail::NonDeduced<T> b) {
+        CALC_TRACE_OP(Subtract, (double)a, (double)b);
+        return element::subtract(a, b);
+    }
+
+    template<typename T>
+    T multiply(detail::NonDeduced<T> a, detail::NonDeduced<T> b) {
+        CALC_TRACE_OP(Multiply, (double)a, (double)b);
+        return element::multiply(a, b);
+    }
+
+    template<typename T>
+    T divide(detail::NonDeduced<T> a, detail::NonDeduced<T> b) {
+        CALC_TRACE_OP(Divide, (double)a, (double)b);
+        if (element::divideError(a, b)) {
+            stickyErrors |= status::DivideByZero;
+            CALC_TRACE_ERROR(DivideByZero);
+        }
+        return element::divide(a, b);
+    }
+
+    template<typename T>
+    T power(detail::NonDeduced<T> base, detail::NonDeduced<T> exponent) {
+        CALC_TRACE_OP(Power, (double)base, (double)exponent);
+        if (element::powerError(base, exponent)) {
+            stickyErrors |= status::DivideByZero;
+            CALC_TRACE_ERROR(DivideByZero);
+        }
+        return element::power(base, exponent);
+    }
+
+    template<typename T>
+    T squareRoot(detail::NonDeduced<T> value) {
+        CALC_TRACE_OP1(SquareRoot, (double)value);
+        if (element::squareRootError(value)) {
+            stickyErrors |= status::NegativeSquareRoot;
+            CALC_TRACE_ERROR(NegativeSquareRoot);
+        }
+        return element::squareRoot(value);
+    }
+
+    template<typename T>
+    void add(const detail::NonDeduced<T>* a, const detail::NonDeduced<T>* b, detail::NonDeduced<T>* out, size_t n) {
+        CALC_TRACE_BATCH(Add, n);
+        dispatch::batch<T>().add(a, b, out, n);
+    }
+
+    template<typename T>
+    void subtract(const detail::NonDeduced<T>* a, const detail::NonDeduced<T>* b, detail::NonDeduced<T>* out, size_t n) {
+        CALC_TRACE_BATCH(Subtract, n);
+        dispatch::batch<T>().subtract(a, b, out, n);
+    }
+
+    template<typename T>
+    void multiply(const detail::NonDeduced<T>* a, const detail::NonDeduced<T>* b, detail::NonDeduced<T>* out, size_t n) {
+        CALC_TRACE_BATCH(Multiply, n);
+        dispatch::batch<T>().multiply(a, b, out, n);
+    }
+
+    template<typename T>
+    void divide(const detail::NonDeduced<T>* a, const detail::NonDeduced<T>* b, detail::NonDeduced<T>* out, size_t n) {
+        CALC_TRACE_BATCH(Divide, n);
+        dispatch::batch<T>().divide(a, b, out, n);
+#if CALC_TRACE_MODE
+        if (calc::trace::enabled() && std::find(b, b + n, (T)0) != b + n) {
+            CALC_TRACE_ERROR(DivideByZero);
+        }
+#endif
+    }
+
+    template<typename T>
+    void power(const detail::NonDeduced<T>* base, const detail::NonDeduced<T>* exponent, detail::NonDeduced<T>* out, size_t n) {
+        CALC_TRACE_BATCH(Power, n);
+        dispatch::batch<T>().power(base, exponent, out, n);
+    }
+
+    template<typename T>
+    void squareRoot(const detail::NonDeduced<T>* values, detail::NonDeduced<T>* out, size_t n) {
+        CALC_TRACE_BATCH(SquareRoot, n);
+        dispatch::batch<T>().squareRoot(values, out, n);
+#if CALC_TRACE_MODE
+        if (calc::trace::enabled() && std::find_if(values, values + n, [](T v) { return v < 0; }) != values + n) {
+            CALC_TRACE_ERROR(NegativeSquareRoot);
         }
-        return sqrt(value);
+#endif
+    }
+
+    #define CALC_DEFINE_ELEMENT_TYPE(T) CALC_ELEMENT_INSTANTIATIONS(template CALC_API, T)
+    CALC_FOR_EACH_ELEMENT_TYPE(CALC_DEFINE_ELEMENT_TYPE)
+    #undef CALC_DEFINE_ELEMENT_TYPE
+
+    //=============================================================================
+    // Checked operations
+    //=============================================================================
+
+    Result divideChecked(double a, double b) {
+        uint32_t flags = (b == 0) ? status::DivideByZero : status::Ok;
+        stickyErrors |= flags;
+        return Result{inline_::divide(a, b), flags};
+    }
+
+    Result squareRootChecked(double value) {
+        uint32_t flags = (value < 0) ? status::NegativeSquareRoot : status::Ok;
+        stickyErrors |= flags;
+        return Result{inline_::squareRoot(value), flags};
+    }
+
+    uint32_t divideChecked(const double* a, const double* b, double* out, size_t n, uint64_t* errorMask) {
+        uint32_t flags = dispatch::table().divideMasked(a, b, out, n, errorMask) ? status::DivideByZero : status::Ok;
+        stickyErrors |= flags;
+        return flags;
+    }
+
+    uint32_t squareRootChecked(const double* values, double* out, size_t n, uint64_t* errorMask) {
+        uint32_t flags = dispatch::table().squareRootMasked(values, out, n, errorMask) ? status::NegativeSquareRoot : status::Ok;
+        stickyErrors |= flags;
+        return flags;
+    }
+
+    uint32_t errors() {
+        return stickyErrors;
+    }
+
+    void clearErrors() {
+        stickyErrors = status::Ok;
     }
 
     void version(void) {
         printf("calc version 1.0.0\n");
     }
-}
\ No newline at end of file
+}
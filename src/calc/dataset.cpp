@@ -0,0 +1,469 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "calc/dataset.h"
+#include "pool.h"
+
+namespace calc {
+    namespace {
+        // Work is handed to threads in chunks of this many binary rows or CSV bytes
+        const size_t CHUNK_ROWS = 65536;
+        const size_t CHUNK_BYTES = (size_t)4 << 20;
+
+        bool mapFile(const std::string& path, const char*& data, size_t& size, void*& mapping, std::string* error) {
+#ifdef _WIN32
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                if (error) {
+                    *error = "cannot open '" + path + "'";
+                }
+                return false;
+            }
+            LARGE_INTEGER length;
+            GetFileSizeEx(file, &length);
+            size = (size_t)length.QuadPart;
+            if (size == 0) {
+                CloseHandle(file);
+                data = "";
+                mapping = nullptr;
+                return true;
+            }
+            HANDLE view = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            CloseHandle(file);
+            data = view ? (const char*)MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (!data) {
+                if (view) {
+                    CloseHandle(view);
+                }
+                if (error) {
+                    *error = "cannot map '" + path + "'";
+                }
+                return false;
+            }
+            mapping = view;
+            return true;
+#else
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                if (error) {
+                    *error = "cannot open '" + path + "'";
+                }
+                return false;
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+                close(fd);
+                if (error) {
+                    *error = "'" + path + "' is not a regular file";
+                }
+                return false;
+            }
+            size = (size_t)info.st_size;
+            mapping = nullptr;
+            if (size == 0) {
+                close(fd);
+                data = "";
+                return true;
+            }
+            void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (map == MAP_FAILED) {
+                if (error) {
+                    *error = "cannot map '" + path + "'";
+                }
+                return false;
+            }
+            madvise(map, size, MADV_SEQUENTIAL);
+            data = (const char*)map;
+            return true;
+#endif
+        }
+
+        void unmapFile(const char* data, size_t size, void* mapping) {
+            if (size == 0) {
+                return;
+            }
+#ifdef _WIN32
+            UnmapViewOfFile(data);
+            CloseHandle((HANDLE)mapping);
+#else
+            (void)mapping;
+            munmap((void*)data, size);
+#endif
+        }
+
+        inline bool isSpace(char c) {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        // One CSV field ending at a comma or end; an empty field is NaN.
+        bool parseField(const char*& p, const char* end, double& value) {
+            while (p < end && isSpace(*p)) {
+                p++;
+            }
+            if (p == end || *p == ',') {
+                value = NAN;
+                return true;
+            }
+#if defined(__cpp_lib_to_chars)
+            std::from_chars_result parsed = std::from_chars(p, end, value);
+            if (parsed.ec != std::errc()) {
+                return false;
+            }
+            p = parsed.ptr;
+#else
+            char buffer[64];
+            size_t length = 0;
+            while (p + length < end && p[length] != ',' && !isSpace(p[length]) && length + 1 < sizeof(buffer)) {
+                buffer[length] = p[length];
+                length++;
+            }
+            buffer[length] = '\0';
+            char* stop;
+            value = strtod(buffer, &stop);
+            if (length == 0 || stop != buffer + length) {
+                return false;
+            }
+            p += length;
+#endif
+            while (p < end && isSpace(*p)) {
+                p++;
+            }
+            return p == end || *p == ',';
+        }
+
+        const char* lineEnd(const char* p, const char* end) {
+            const char* newline = (const char*)memchr(p, '\n', (size_t)(end - p));
+            return newline ? newline : end;
+        }
+
+        // Results of one chunk, held until every earlier chunk has been delivered
+        struct ChunkResult {
+            std::vector<double> values;
+            size_t lines = 0;           // CSV lines consumed, for error positions
+            std::string error;          // set when the chunk stopped early
+            size_t errorLine = 0;       // line of the error, relative to the chunk
+        };
+    }
+
+    Dataset::~Dataset() {
+        close();
+    }
+
+    void Dataset::close() {
+        if (data_) {
+            unmapFile(data_, size_, mapping_);
+        }
+        columns_.clear();
+        data_ = nullptr;
+        size_ = 0;
+        start_ = 0;
+        rows_ = 0;
+        csv_ = false;
+        mapping_ = nullptr;
+    }
+
+    bool Dataset::openBinary(const std::string& path, const std::vector<std::string>& columns, Layout layout, std::string* error) {
+        close();
+        if (columns.empty()) {
+            if (error) {
+                *error = "a binary dataset needs at least one column name";
+            }
+            return false;
+        }
+        if (!mapFile(path, data_, size_, mapping_, error)) {
+            data_ = nullptr;
+            return false;
+        }
+        size_t record = columns.size() * sizeof(double);
+        if (size_ % record != 0) {
+            if (error) {
+                char message[160];
+                snprintf(message, sizeof(message), "file size %zu is not a multiple of %zu columns of doubles", size_, columns.size());
+                *error = message;
+            }
+            close();
+            return false;
+        }
+        columns_ = columns;
+        rows_ = size_ / record;
+        layout_ = layout;
+        return true;
+    }
+
+    bool Dataset::openCsv(const std::string& path, std::string* error) {
+        close();
+        if (!mapFile(path, data_, size_, mapping_, error)) {
+            data_ = nullptr;
+            return false;
+        }
+        if (size_ == 0) {
+            if (error) {
+                *error = "the CSV file is empty";
+            }
+            close();
+            return false;
+        }
+        const char* end = data_ + size_;
+        const char* header = lineEnd(data_, end);
+        for (const char* p = data_; p <= header;) {
+            const char* comma = (const char*)memchr(p, ',', (size_t)(header - p));
+            const char* stop = comma ? comma : header;
+            const char* first = p;
+            while (first < stop && isSpace(*first)) {
+                first++;
+            }
+            const char* last = stop;
+            while (last > first && isSpace(last[-1])) {
+                last--;
+            }
+            columns_.emplace_back(first, last);
+            if (columns_.back().empty()) {
+                if (error) {
+                    *error = "the CSV header has an empty column name";
+                }
+                close();
+                return false;
+            }
+            p = stop + 1;
+        }
+        start_ = header < end ? (size_t)(header - data_) + 1 : size_;
+        csv_ = true;
+        return true;
+    }
+
+    int Dataset::columnIndex(const std::string& name) const {
+        for (size_t i = 0; i < columns_.size(); i++) {
+            if (columns_[i] == name) {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    // Cuts a dataset into chunks and turns each into the expression's input columns.
+    struct DatasetReader {
+        const Dataset& dataset;
+        std::vector<int> sources;       // dataset column of each expression variable
+        std::vector<int> slots;         // variable slot of each dataset column, or -1
+        std::atomic<bool> cancelled{false};
+        std::mutex mutex;
+        size_t next = 0;                // next row (binary) or byte (CSV)
+        size_t sequence = 0;
+
+        explicit DatasetReader(const Dataset& dataset) : dataset(dataset) {}
+
+        bool take(size_t& chunk, size_t& begin, size_t& end) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (cancelled.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            size_t total = dataset.csv_ ? dataset.size_ : dataset.rows_;
+            size_t position = dataset.csv_ ? std::max(next, dataset.start_) : next;
+            if (position >= total) {
+                return false;
+            }
+            begin = position;
+            if (dataset.csv_) {
+                end = position + CHUNK_BYTES < total ? position + CHUNK_BYTES : total;
+                if (end < total) {
+                    end = (size_t)(lineEnd(dataset.data_ + end, dataset.data_ + total) - dataset.data_);
+                    end = end < total ? end + 1 : total;
+                }
+            } else {
+                end = std::min(total, position + CHUNK_ROWS);
+            }
+            next = end;
+            chunk = sequence++;
+            return true;
+        }
+
+        // Fills inputs (one pointer per variable) for rows [begin, end) of a binary file
+        size_t loadBinary(size_t begin, size_t end, std::vector<const double*>& inputs, std::vector<std::vector<double>>& storage) {
+            size_t count = end - begin;
+            const double* base = (const double*)dataset.data_;
+            size_t columns = dataset.columns_.size();
+            for (size_t v = 0; v < sources.size(); v++) {
+                if (dataset.layout_ == Dataset::Layout::Columns) {
+                    inputs[v] = base + (size_t)sources[v] * dataset.rows_ + begin;
+                    continue;
+                }
+                storage[v].resize(count);
+                double* out = storage[v].data();
+                const double* in = base + begin * columns + (size_t)sources[v];
+                for (size_t i = 0; i < count; i++) {
+                    out[i] = in[i * columns];
+                }
+                inputs[v] = out;
+            }
+            return count;
+        }
+
+        // Parses the CSV lines in bytes [begin, end) into one vector per variable,
+        // stopping at the first bad line.
+        size_t loadCsv(size_t begin, size_t end, std::vector<const double*>& inputs, std::vector<std::vector<double>>& storage, ChunkResult& result) {
+            const char* p = dataset.data_ + begin;
+            const char* stop = dataset.data_ + end;
+            size_t variables = sources.size();
+            size_t columns = dataset.columns_.size();
+            for (std::vector<double>& column : storage) {
+                column.clear();
+            }
+            std::vector<double> row(variables);
+            size_t rows = 0;
+            while (p < stop) {
+                const char* line = lineEnd(p, stop);
+                const char* next = line < stop ? line + 1 : stop;
+                result.lines++;
+                const char* q = p;
+                while (q < line && isSpace(*q)) {
+                    q++;
+                }
+                if (q == line) {
+                    p = next;
+                    continue;
+                }
+                size_t field = 0;
+                const char* f = p;
+                while (true) {
+                    if (field >= columns) {
+                        result.error = "more fields than columns";
+                        break;
+                    }
+                    int slot = slots[field];
+                    if (slot >= 0) {
+                        if (!parseField(f, line, row[(size_t)slot])) {
+                            result.error = "column '" + dataset.columns_[field] + "' is not a number";
+                            break;
+                        }
+                    } else {
+                        const char* comma = (const char*)memchr(f, ',', (size_t)(line - f));
+                        f = comma ? comma : line;
+                    }
+                    field++;
+                    if (f == line) {
+                        break;
+                    }
+                    f++;
+                }
+                if (result.error.empty() && field != columns) {
+                    result.error = "fewer fields than columns";
+                }
+                if (!result.error.empty()) {
+                    result.errorLine = result.lines - 1;
+                    break;
+                }
+                for (size_t v = 0; v < variables; v++) {
+                    storage[v].push_back(row[v]);
+                }
+                rows++;
+                p = next;
+            }
+            for (size_t v = 0; v < variables; v++) {
+                inputs[v] = storage[v].data();
+            }
+            return rows;
+        }
+    };
+
+    bool evaluate(const Expression& expression, const Dataset& dataset, const DatasetSink& sink, const DatasetOptions& options, std::string* error) {
+        if (!expression.valid() || !dataset.isOpen()) {
+            if (error) {
+                *error = !expression.valid() ? "invalid expression" : "dataset is not open";
+            }
+            return false;
+        }
+        DatasetReader reader(dataset);
+        reader.slots.assign(dataset.columns().size(), -1);
+        for (size_t v = 0; v < expression.variables().size(); v++) {
+            int column = dataset.columnIndex(expression.variables()[v]);
+            if (column < 0) {
+                if (error) {
+                    *error = "no column named '" + expression.variables()[v] + "'";
+                }
+                return false;
+            }
+            reader.sources.push_back(column);
+            reader.slots[(size_t)column] = (int)v;
+        }
+
+        unsigned threads = options.threads ? options.threads : pool::hardwareThreads();
+        size_t window = 2 * (size_t)threads;
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::map<size_t, ChunkResult> pending;
+        size_t nextChunk = 0;
+        size_t nextRow = 0;
+        size_t nextLine = 2;    // CSV line numbers, after the header
+        bool stopped = false;
+        std::string failure;
+
+        // Delivers finished chunks in order; called with mutex held
+        auto deliver = [&] {
+            while (!stopped && !pending.empty() && pending.begin()->first == nextChunk) {
+                ChunkResult& result = pending.begin()->second;
+                size_t count = result.values.size();
+                if (count && !sink(nextRow, result.values.data(), count)) {
+                    stopped = true;
+                    failure = "stopped by the caller";
+                }
+                nextRow += count;
+                if (!stopped && !result.error.empty()) {
+                    stopped = true;
+                    failure = "line " + std::to_string(nextLine + result.errorLine) + ": " + result.error;
+                }
+                nextLine += result.lines;
+                pending.erase(pending.begin());
+                nextChunk++;
+            }
+            if (stopped) {
+                reader.cancelled = true;
+            }
+            ready.notify_all();
+        };
+
+        pool::parallelFor(threads, threads, [&](size_t) {
+            std::vector<const double*> inputs(reader.sources.size());
+            std::vector<std::vector<double>> storage(reader.sources.size());
+            size_t chunk, begin, end;
+            while (reader.take(chunk, begin, end)) {
+                ChunkResult result;
+                size_t rows = dataset.isCsv() ? reader.loadCsv(begin, end, inputs, storage, result)
+                                              : reader.loadBinary(begin, end, inputs, storage);
+                result.values.resize(rows);
+                expression.evaluate(inputs.data(), result.values.data(), rows);
+
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&] { return stopped || chunk < nextChunk + window; });
+                if (stopped) {
+                    return;
+                }
+                pending.emplace(chunk, std::move(result));
+                deliver();
+            }
+        });
+
+        if (stopped && error) {
+            *error = failure;
+        }
+        return !stopped;
+    }
+}
@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <string.h>
+#include "kernel_table.h"
+
+namespace calc {
+    namespace {
+        bool cpuSupports(Isa isa) {
+            switch (isa) {
+                case Isa::Generic:
+                    return true;
+#if CALC_DISPATCH_X86
+                // libgcc also checks that the OS saves the wider register state (XCR0)
+                case Isa::Avx2:
+                    __builtin_cpu_init();
+                    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+                case Isa::Avx512:
+                    __builtin_cpu_init();
+                    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq");
+#endif
+                default:
+                    return false;
+            }
+        }
+
+        // The ceiling requested through CALC_ISA, or the highest level if unset or unknown.
+        Isa requestedLimit() {
+            const char* env = getenv("CALC_ISA");
+            if (env) {
+                for (Isa isa : {Isa::Generic, Isa::Avx2, Isa::Avx512}) {
+                    if (strcmp(env, cpu::name(isa)) == 0) {
+                        return isa;
+                    }
+                }
+            }
+            return Isa::Avx512;
+        }
+
+        const dispatch::Table& resolve() {
+            Isa limit = requestedLimit();
+#if CALC_DISPATCH_X86
+            if (limit >= Isa::Avx512 && cpuSupports(Isa::Avx512)) {
+                return dispatch::avx512Table;
+            }
+            if (limit >= Isa::Avx2 && cpuSupports(Isa::Avx2)) {
+                return dispatch::avx2Table;
+            }
+#else
+            (void)limit;
+#endif
+            return dispatch::genericTable;
+        }
+    }
+
+    namespace dispatch {
+        const Table& table() {
+            static const Table& selected = resolve();
+            return selected;
+        }
+    }
+
+    namespace cpu {
+        Isa active() {
+            return dispatch::table().isa;
+        }
+
+        bool supported(Isa isa) {
+            return cpuSupports(isa);
+        }
+
+        const char* name(Isa isa) {
+            switch (isa) {
+                case Isa::Generic:
+                    return "generic";
+                case Isa::Avx2:
+                    return "avx2";
+                case Isa::Avx512:
+                    return "avx512";
+            }
+            return "unknown";
+        }
+    }
+}
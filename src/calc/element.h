@@ -0,0 +1,161 @@
+#pragma once
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <type_traits>
+
+// Per-element rules of the calc operations for every supported element type.
+//
+// Floating-point types follow calc::inline_ exactly (for double the results are
+// identical). Integer types wrap around on overflow like unsigned arithmetic, truncate
+// quotients toward zero, and take the floor of square roots. Division by zero and
+// square roots of negative numbers yield 0 for every type.
+//
+// The functions have internal linkage because kernels_impl.h includes this header in
+// builds with different -m flags; see the note there. For the same reason they call
+// the C library (sqrtf, powl, ...) rather than the inline std:: overloads for float
+// and long double, which are emitted out of line at -O0.
+namespace calc {
+namespace element {
+    namespace {
+        template<typename T>
+        using Unsigned = typename std::make_unsigned<T>::type;
+
+        inline float absolute(float v) { return fabsf(v); }
+        inline double absolute(double v) { return fabs(v); }
+        inline long double absolute(long double v) { return fabsl(v); }
+
+        inline float root(float v) { return sqrtf(v); }
+        inline double root(double v) { return sqrt(v); }
+        inline long double root(long double v) { return sqrtl(v); }
+
+        inline float raise(float b, float e) { return powf(b, e); }
+        inline double raise(double b, double e) { return pow(b, e); }
+        inline long double raise(long double b, long double e) { return powl(b, e); }
+
+        // Nonzero, finite and not subnormal
+        inline bool isNormal(float v) { return absolute(v) >= FLT_MIN && absolute(v) <= FLT_MAX; }
+        inline bool isNormal(double v) { return absolute(v) >= DBL_MIN && absolute(v) <= DBL_MAX; }
+        inline bool isNormal(long double v) { return absolute(v) >= LDBL_MIN && absolute(v) <= LDBL_MAX; }
+
+        template<typename T>
+        inline T add(T a, T b) {
+            if constexpr (std::is_integral<T>::value) {
+                return (T)((Unsigned<T>)a + (Unsigned<T>)b);
+            } else {
+                return a + b;
+            }
+        }
+
+        template<typename T>
+        inline T subtract(T a, T b) {
+            if constexpr (std::is_integral<T>::value) {
+                return (T)((Unsigned<T>)a - (Unsigned<T>)b);
+            } else {
+                return a - b;
+            }
+        }
+
+        template<typename T>
+        inline T multiply(T a, T b) {
+            if constexpr (std::is_integral<T>::value) {
+                return (T)((Unsigned<T>)a * (Unsigned<T>)b);
+            } else {
+                return a * b;
+            }
+        }
+
+        template<typename T>
+        inline T divide(T a, T b) {
+            if constexpr (std::is_integral<T>::value) {
+                // The minimum value divided by -1 overflows; wrap it like the other operations
+                if (b == -1) {
+                    return (T)(0 - (Unsigned<T>)a);
+                }
+            }
+            return b == 0 ? (T)0 : a / b;
+        }
+
+        template<typename T>
+        inline T squareRoot(T value) {
+            if constexpr (std::is_integral<T>::value) {
+                if (value <= 0) {
+                    return 0;
+                }
+                // The double estimate can be off by one for 64-bit values; x <= v / x avoids overflow.
+                T r = (T)sqrt((double)value);
+                while (r > value / r) {
+                    r--;
+                }
+                while (r + 1 <= value / (r + 1)) {
+                    r++;
+                }
+                return r;
+            } else {
+                return root(value < 0 ? (T)0 : value);
+            }
+        }
+
+        // x^n by repeated squaring, as calc::inline_::integerPower.
+        template<typename T>
+        inline T integerPower(T x, uint64_t n) {
+            T r = 1;
+            while (n) {
+                if (n & 1) {
+                    r = multiply(r, x);
+                }
+                n >>= 1;
+                if (n) {
+                    x = multiply(x, x);
+                }
+            }
+            return r;
+        }
+
+        const int POWER_CHAIN_LIMIT = 4;
+
+        template<typename T>
+        inline T power(T base, T exponent) {
+            if constexpr (std::is_integral<T>::value) {
+                if (exponent >= 0) {
+                    return integerPower(base, (uint64_t)exponent);
+                }
+                // Truncated reciprocals: only 1 and -1 survive; 0 counts as division by zero
+                if (base == 1 || base == -1) {
+                    return (exponent & 1) ? base : (T)1;
+                }
+                return 0;
+            } else {
+                if (exponent == 2) {
+                    return base * base;
+                }
+                if (absolute(exponent) <= POWER_CHAIN_LIMIT && exponent == (T)(int)exponent) {
+                    int n = (int)exponent;
+                    T r = integerPower(base, (uint64_t)(n < 0 ? -n : n));
+                    if (isNormal(r)) {
+                        return n < 0 ? 1 / r : r;
+                    }
+                }
+                return raise(base, exponent);
+            }
+        }
+
+        // Whether an operation on these operands hits a status:: error
+        template<typename T>
+        inline bool divideError(T, T b) {
+            return b == 0;
+        }
+
+        template<typename T>
+        inline bool powerError(T base, T exponent) {
+            return std::is_integral<T>::value && base == 0 && exponent < 0;
+        }
+
+        template<typename T>
+        inline bool squareRootError(T value) {
+            return value < 0;
+        }
+    }
+}
+}
@@ -0,0 +1,565 @@
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <algorithm>
+#include <unordered_map>
+#include "calc/calc_inline.h"
+#include "calc/expression.h"
+#include "kernel_table.h"
+
+namespace calc {
+
+    static inline double applyOp(OpCode op, double a, double b) {
+        switch (op) {
+            case OpCode::Neg: return -a;
+            case OpCode::Add: return inline_::add(a, b);
+            case OpCode::Subtract: return inline_::subtract(a, b);
+            case OpCode::Multiply: return inline_::multiply(a, b);
+            case OpCode::Divide: return inline_::divide(a, b);
+            case OpCode::Power: return inline_::power(a, b);
+            case OpCode::SquareRoot: return inline_::squareRoot(a);
+        }
+        return 0;
+    }
+
+    static const char* opName(OpCode op) {
+        switch (op) {
+            case OpCode::Neg: return "neg";
+            case OpCode::Add: return "add";
+            case OpCode::Subtract: return "sub";
+            case OpCode::Multiply: return "mul";
+            case OpCode::Divide: return "div";
+            case OpCode::Power: return "pow";
+            case OpCode::SquareRoot: return "sqrt";
+        }
+        return "?";
+    }
+
+    static bool isUnary(OpCode op) {
+        return op == OpCode::Neg || op == OpCode::SquareRoot;
+    }
+
+    namespace {
+        enum class NodeKind : uint8_t { Variable, Constant, Operation };
+
+        struct Node {
+            NodeKind kind;
+            OpCode op;
+            int a, b;       // operand nodes for operations, variable index for variables
+            double value;   // constants only
+        };
+
+        // Builds a DAG of hash-consed nodes: identical subexpressions map to the same
+        // node and operations on constants are folded as they are created.
+        class Builder {
+        public:
+            std::vector<Node> nodes;
+            std::vector<std::string> variables;
+
+            int variable(const std::string& name) {
+                int index = -1;
+                for (size_t i = 0; i < variables.size(); i++) {
+                    if (variables[i] == name) {
+                        index = (int)i;
+                        break;
+                    }
+                }
+                if (index < 0) {
+                    index = (int)variables.size();
+                    variables.push_back(name);
+                }
+                return intern(Node{NodeKind::Variable, OpCode::Neg, index, -1, 0.0});
+            }
+
+            int constant(double value) {
+                return intern(Node{NodeKind::Constant, OpCode::Neg, -1, -1, value});
+            }
+
+            int operation(OpCode op, int a, int b = -1) {
+                const Node& left = nodes[a];
+                if (isUnary(op)) {
+                    if (left.kind == NodeKind::Constant) {
+                        return constant(applyOp(op, left.value, 0.0));
+                    }
+                    // -(-x) == x exactly
+                    if (op == OpCode::Neg && left.kind == NodeKind::Operation && left.op == OpCode::Neg) {
+                        return left.a;
+                    }
+                    return intern(Node{NodeKind::Operation, op, a, -1, 0.0});
+                }
+                const Node& right = nodes[b];
+                if (left.kind == NodeKind::Constant && right.kind == NodeKind::Constant) {
+                    return constant(applyOp(op, left.value, right.value));
+                }
+                // Identities that hold bit-for-bit in IEEE arithmetic
+                if (right.kind == NodeKind::Constant) {
+                    if ((op == OpCode::Multiply || op == OpCode::Divide || op == OpCode::Power) && right.value == 1.0) {
+                        return a;
+                    }
+                    if (op == OpCode::Subtract && right.value == 0.0 && !signbit(right.value)) {
+                        return a;
+                    }
+                    // power() evaluates x^2 as x*x, so it can share nodes with other products
+                    if (op == OpCode::Power && right.value == 2.0) {
+                        return operation(OpCode::Multiply, a, a);
+                    }
+                }
+                if (op == OpCode::Multiply && left.kind == NodeKind::Constant && left.value == 1.0) {
+                    return b;
+                }
+                // Canonical operand order lets a+b and b+a share a node
+                if ((op == OpCode::Add || op == OpCode::Multiply) && a > b) {
+                    int t = a;
+                    a = b;
+                    b = t;
+                }
+                return intern(Node{NodeKind::Operation, op, a, b, 0.0});
+            }
+
+        private:
+            struct Key {
+                NodeKind kind;
+                OpCode op;
+                int a, b;
+                uint64_t bits;
+                bool operator==(const Key& o) const {
+                    return kind == o.kind && op == o.op && a == o.a && b == o.b && bits == o.bits;
+                }
+            };
+            struct KeyHash {
+                size_t operator()(const Key& k) const {
+                    uint64_t h = (uint64_t)k.kind * 0x9E3779B97F4A7C15ull;
+                    h ^= ((uint64_t)k.op + 0x632BE59BD9B4E019ull) + (h << 6) + (h >> 2);
+                    h ^= ((uint64_t)(uint32_t)k.a + 0x85EBCA77C2B2AE63ull) + (h << 6) + (h >> 2);
+                    h ^= ((uint64_t)(uint32_t)k.b + 0xC2B2AE3D27D4EB4Full) + (h << 6) + (h >> 2);
+                    h ^= k.bits + (h << 6) + (h >> 2);
+                    return (size_t)h;
+                }
+            };
+            std::unordered_map<Key, int, KeyHash> index_;
+
+            int intern(const Node& node) {
+                Key key{node.kind, node.op, node.a, node.b, 0};
+                if (node.kind == NodeKind::Constant) {
+                    memcpy(&key.bits, &node.value, sizeof(key.bits));
+                }
+                auto found = index_.find(key);
+                if (found != index_.end()) {
+                    return found->second;
+                }
+                int id = (int)nodes.size();
+                nodes.push_back(node);
+                index_.emplace(key, id);
+                return id;
+            }
+        };
+
+        // Recursive-descent parser:
+        //   expr    := term (('+' | '-') term)*
+        //   term    := unary (('*' | '/') unary)*
+        //   unary   := '-' unary | power
+        //   power   := primary ('^' unary)?
+        //   primary := number | name | name '(' expr (',' expr)* ')' | '(' expr ')'
+        class Parser {
+        public:
+            Parser(const std::string& text, Builder& builder) : text_(text), builder_(builder), pos_(0) {}
+
+            bool parse(int& root, std::string& error) {
+                root = expr();
+                if (root >= 0) {
+                    skipSpace();
+                    if (pos_ != text_.size()) {
+                        fail("unexpected input");
+                        root = -1;
+                    }
+                }
+                error = error_;
+                return root >= 0;
+            }
+
+        private:
+            const std::string& text_;
+            Builder& builder_;
+            size_t pos_;
+            std::string error_;
+
+            int fail(const char* message) {
+                if (error_.empty()) {
+                    char buffer[128];
+                    if (pos_ < text_.size()) {
+                        snprintf(buffer, sizeof(buffer), "%s at position %zu ('%c')", message, pos_, text_[pos_]);
+                    } else {
+                        snprintf(buffer, sizeof(buffer), "%s at end of input", message);
+                    }
+                    error_ = buffer;
+                }
+                return -1;
+            }
+
+            void skipSpace() {
+                while (pos_ < text_.size() && isspace((unsigned char)text_[pos_])) {
+                    pos_++;
+                }
+            }
+
+            bool accept(char c) {
+                skipSpace();
+                if (pos_ < text_.size() && text_[pos_] == c) {
+                    pos_++;
+                    return true;
+                }
+                return false;
+            }
+
+            int expr() {
+                int left = term();
+                while (left >= 0) {
+                    if (accept('+')) {
+                        int right = term();
+                        left = right < 0 ? -1 : builder_.operation(OpCode::Add, left, right);
+                    } else if (accept('-')) {
+                        int right = term();
+                        left = right < 0 ? -1 : builder_.operation(OpCode::Subtract, left, right);
+                    } else {
+                        break;
+                    }
+                }
+                return left;
+            }
+
+            int term() {
+                int left = unary();
+                while (left >= 0) {
+                    if (accept('*')) {
+                        int right = unary();
+                        left = right < 0 ? -1 : builder_.operation(OpCode::Multiply, left, right);
+                    } else if (accept('/')) {
+                        int right = unary();
+                        left = right < 0 ? -1 : builder_.operation(OpCode::Divide, left, right);
+                    } else {
+                        break;
+                    }
+                }
+                return left;
+            }
+
+            int unary() {
+                if (accept('-')) {
+                    int operand = unary();
+                    return operand < 0 ? -1 : builder_.operation(OpCode::Neg, operand);
+                }
+                if (accept('+')) {
+                    return unary();
+                }
+                return powerTerm();
+            }
+
+            int powerTerm() {
+                int base = primary();
+                if (base >= 0 && accept('^')) {
+                    int exponent = unary();
+                    return exponent < 0 ? -1 : builder_.operation(OpCode::Power, base, exponent);
+                }
+                return base;
+            }
+
+            int primary() {
+                skipSpace();
+                if (pos_ >= text_.size()) {
+                    return fail("expected operand");
+                }
+                char c = text_[pos_];
+                if (isdigit((unsigned char)c) || c == '.') {
+                    const char* begin = text_.c_str() + pos_;
+                    char* end = nullptr;
+                    double value = strtod(begin, &end);
+                    if (end == begin) {
+                        return fail("invalid number");
+                    }
+                    pos_ += (size_t)(end - begin);
+                    return builder_.constant(value);
+                }
+                if (isalpha((unsigned char)c) || c == '_') {
+                    size_t start = pos_;
+                    while (pos_ < text_.size() && (isalnum((unsigned char)text_[pos_]) || text_[pos_] == '_')) {
+                        pos_++;
+                    }
+                    std::string name = text_.substr(start, pos_ - start);
+                    if (accept('(')) {
+                        return call(name, start);
+                    }
+                    return builder_.variable(name);
+                }
+                if (accept('(')) {
+                    int inner = expr();
+                    if (inner >= 0 && !accept(')')) {
+                        return fail("expected ')'");
+                    }
+                    return inner;
+                }
+                return fail("unexpected character");
+            }
+
+            int call(const std::string& name, size_t start) {
+                std::vector<int> args;
+                if (!accept(')')) {
+                    do {
+                        int arg = expr();
+                        if (arg < 0) {
+                            return -1;
+                        }
+                        args.push_back(arg);
+                    } while (accept(','));
+                    if (!accept(')')) {
+                        return fail("expected ')'");
+                    }
+                }
+
+                struct Function {
+                    const char* name;
+                    OpCode op;
+                    size_t arity;
+                };
+                static const Function functions[] = {
+                    {"add", OpCode::Add, 2},
+                    {"subtract", OpCode::Subtract, 2},
+                    {"multiply", OpCode::Multiply, 2},
+                    {"divide", OpCode::Divide, 2},
+                    {"pow", OpCode::Power, 2},
+                    {"power", OpCode::Power, 2},
+                    {"sqrt", OpCode::SquareRoot, 1},
+                    {"squareRoot", OpCode::SquareRoot, 1},
+                };
+                for (const Function& f : functions) {
+                    if (name == f.name) {
+                        if (args.size() != f.arity) {
+                            pos_ = start;
+                            return fail(f.arity == 1 ? "function takes one argument" : "function takes two arguments");
+                        }
+                        return builder_.operation(f.op, args[0], f.arity == 2 ? args[1] : -1);
+                    }
+                }
+                pos_ = start;
+                return fail("unknown function");
+            }
+        };
+    }
+
+    //=============================================================================
+    // Expression Implementation
+    //=============================================================================
+
+    Expression::Expression() : registerCount_(0), result_(0), valid_(false) {
+    }
+
+    Expression::Expression(const std::string& source) : Expression() {
+        compile(source);
+    }
+
+    bool Expression::compile(const std::string& source, std::string* error) {
+        source_ = source;
+        variables_.clear();
+        constants_.clear();
+        code_.clear();
+        registerCount_ = 0;
+        result_ = 0;
+        valid_ = false;
+
+        Builder builder;
+        Parser parser(source, builder);
+        int root = -1;
+        std::string message;
+        if (!parser.parse(root, message)) {
+            if (error) {
+                *error = message;
+            }
+            return false;
+        }
+
+        const std::vector<Node>& nodes = builder.nodes;
+        variables_ = builder.variables;
+
+        // Nodes are created children-first, so id order is already a topological order.
+        std::vector<bool> live(nodes.size(), false);
+        std::vector<int> lastUse(nodes.size(), -1);
+        live[root] = true;
+        for (int id = root; id >= 0; id--) {
+            if (!live[id] || nodes[id].kind != NodeKind::Operation) {
+                continue;
+            }
+            live[nodes[id].a] = true;
+            lastUse[nodes[id].a] = std::max(lastUse[nodes[id].a], id);
+            if (nodes[id].b >= 0) {
+                live[nodes[id].b] = true;
+                lastUse[nodes[id].b] = std::max(lastUse[nodes[id].b], id);
+            }
+        }
+
+        const size_t maxRegisters = 65536;
+        std::vector<uint32_t> reg(nodes.size(), 0);
+        size_t nextRegister = variables_.size();
+        for (size_t id = 0; id < nodes.size(); id++) {
+            if (!live[id]) {
+                continue;
+            }
+            if (nodes[id].kind == NodeKind::Variable) {
+                reg[id] = (uint32_t)nodes[id].a;
+            } else if (nodes[id].kind == NodeKind::Constant) {
+                reg[id] = (uint32_t)nextRegister++;
+                constants_.push_back(nodes[id].value);
+            }
+        }
+
+        // Temporaries are reused once their last reader has executed.
+        std::vector<uint32_t> freeRegisters;
+        for (size_t id = 0; id < nodes.size(); id++) {
+            const Node& node = nodes[id];
+            if (!live[id] || node.kind != NodeKind::Operation) {
+                continue;
+            }
+            uint32_t a = reg[node.a];
+            uint32_t b = node.b >= 0 ? reg[node.b] : a;
+            for (int operand : {node.a, node.b}) {
+                if (operand >= 0 && lastUse[operand] == (int)id && nodes[operand].kind == NodeKind::Operation &&
+                    !(operand == node.b && node.a == node.b)) {
+                    freeRegisters.push_back(reg[operand]);
+                }
+            }
+            if (!freeRegisters.empty()) {
+                reg[id] = freeRegisters.back();
+                freeRegisters.pop_back();
+            } else {
+                reg[id] = (uint32_t)nextRegister++;
+            }
+            if (nextRegister > maxRegisters) {
+                if (error) {
+                    *error = "expression needs too many registers";
+                }
+                variables_.clear();
+                constants_.clear();
+                code_.clear();
+                return false;
+            }
+            code_.push_back(Instruction{node.op, (uint16_t)reg[id], (uint16_t)a, (uint16_t)b});
+        }
+
+        registerCount_ = std::max<size_t>(nextRegister, 1);
+        result_ = (uint16_t)reg[root];
+        valid_ = true;
+        if (error) {
+            error->clear();
+        }
+        return true;
+    }
+
+    int Expression::variableIndex(const std::string& name) const {
+        for (size_t i = 0; i < variables_.size(); i++) {
+            if (variables_[i] == name) {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    double Expression::evaluate(const double* values) const {
+        static thread_local std::vector<double> scratch;
+        if (scratch.size() < registerCount_) {
+            scratch.resize(registerCount_);
+        }
+        return evaluate(values, scratch.data());
+    }
+
+    double Expression::evaluate(const double* values, double* registers) const {
+        if (!valid_) {
+            return 0;
+        }
+        size_t variableCount = variables_.size();
+        if (variableCount) {
+            memcpy(registers, values, variableCount * sizeof(double));
+        }
+        if (!constants_.empty()) {
+            memcpy(registers + variableCount, constants_.data(), constants_.size() * sizeof(double));
+        }
+        for (const Instruction& ins : code_) {
+            registers[ins.dst] = applyOp(ins.op, registers[ins.a], registers[ins.b]);
+        }
+        return registers[result_];
+    }
+
+    // Rows go through the program one tile at a time, so every register's tile stays in
+    // L1 while each instruction runs as one batch kernel call over it. Variables read the
+    // columns in place; constants are broadcast once per call.
+    void Expression::evaluate(const double* const* columns, double* out, size_t n) const {
+        const size_t TILE = 256;
+        if (!valid_) {
+            std::fill(out, out + n, 0.0);
+            return;
+        }
+        size_t variableCount = variables_.size();
+        static thread_local std::vector<double> scratchBuffer;
+        static thread_local std::vector<const double*> inputBuffer;
+        scratchBuffer.resize((registerCount_ - std::min(variableCount, registerCount_)) * TILE);
+        inputBuffer.resize(registerCount_);
+        double* scratch = scratchBuffer.data();
+        const double** inputs = inputBuffer.data();
+        for (size_t c = 0; c < constants_.size(); c++) {
+            std::fill(scratch + c * TILE, scratch + (c + 1) * TILE, constants_[c]);
+        }
+        for (size_t r = variableCount; r < registerCount_; r++) {
+            inputs[r] = scratch + (r - variableCount) * TILE;
+        }
+
+        const dispatch::BatchTable<double>& batch = dispatch::batch<double>();
+        for (size_t start = 0; start < n; start += TILE) {
+            size_t count = std::min(TILE, n - start);
+            for (size_t v = 0; v < variableCount; v++) {
+                inputs[v] = columns[v] + start;
+            }
+            for (const Instruction& ins : code_) {
+                double* dst = scratch + (ins.dst - variableCount) * TILE;
+                const double* a = inputs[ins.a];
+                const double* b = inputs[ins.b];
+                switch (ins.op) {
+                    case OpCode::Neg:
+                        for (size_t i = 0; i < count; i++) {
+                            dst[i] = -a[i];
+                        }
+                        break;
+                    case OpCode::Add: batch.add(a, b, dst, count); break;
+                    case OpCode::Subtract: batch.subtract(a, b, dst, count); break;
+                    case OpCode::Multiply: batch.multiply(a, b, dst, count); break;
+                    case OpCode::Divide: batch.divide(a, b, dst, count); break;
+                    case OpCode::Power: batch.power(a, b, dst, count); break;
+                    case OpCode::SquareRoot: batch.squareRoot(a, dst, count); break;
+                }
+            }
+            memcpy(out + start, inputs[result_], count * sizeof(double));
+        }
+    }
+
+    std::string Expression::disassemble() const {
+        std::string text;
+        char line[96];
+        for (size_t i = 0; i < variables_.size(); i++) {
+            snprintf(line, sizeof(line), "r%zu = %s\n", i, variables_[i].c_str());
+            text += line;
+        }
+        for (size_t i = 0; i < constants_.size(); i++) {
+            snprintf(line, sizeof(line), "r%zu = %.17g\n", variables_.size() + i, constants_[i]);
+            text += line;
+        }
+        for (const Instruction& ins : code_) {
+            if (isUnary(ins.op)) {
+                snprintf(line, sizeof(line), "r%u = %s r%u\n", ins.dst, opName(ins.op), ins.a);
+            } else {
+                snprintf(line, sizeof(line), "r%u = %s r%u, r%u\n", ins.dst, opName(ins.op), ins.a, ins.b);
+            }
+            text += line;
+        }
+        snprintf(line, sizeof(line), "ret r%u\n", result_);
+        text += line;
+        return text;
+    }
+}
@@ -0,0 +1,267 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "calc/calc_inline.h"
+#include "calc/jit.h"
+
+#if defined(__linux__) && defined(__x86_64__)
+    #include <sys/mman.h>
+    #include <unistd.h>
+    #define CALC_JIT_X86_64 1
+#else
+    #define CALC_JIT_X86_64 0
+#endif
+
+namespace calc {
+
+#if CALC_JIT_X86_64
+    namespace {
+        // Base registers used to address the three register-file regions.
+        enum class Base : uint8_t {
+            Values,     // rbx: caller's variable array
+            Constants,  // r13: constant pool appended after the code
+            Frame       // rsp: temporaries spilled to the stack frame
+        };
+
+        struct Operand {
+            Base base;
+            int32_t disp;
+        };
+
+        class Assembler {
+        public:
+            std::vector<uint8_t> bytes;
+
+            void byte(uint8_t b) { bytes.push_back(b); }
+
+            void bytes8(uint64_t v) {
+                for (int i = 0; i < 8; i++) {
+                    byte((uint8_t)(v >> (8 * i)));
+                }
+            }
+
+            void bytes4(uint32_t v) {
+                for (int i = 0; i < 4; i++) {
+                    byte((uint8_t)(v >> (8 * i)));
+                }
+            }
+
+            // ModRM (+SIB) with a 32-bit displacement; reg is the low three bits of the register field.
+            void memory(uint8_t reg, const Operand& m) {
+                switch (m.base) {
+                    case Base::Values:
+                        byte((uint8_t)(0x80 | (reg << 3) | 3));
+                        break;
+                    case Base::Constants:
+                        byte((uint8_t)(0x80 | (reg << 3) | 5));
+                        break;
+                    case Base::Frame:
+                        byte((uint8_t)(0x80 | (reg << 3) | 4));
+                        byte(0x24);
+                        break;
+                }
+                bytes4((uint32_t)m.disp);
+            }
+
+            // prefix [REX.B] 0F op /r  for xmm<reg> and a memory operand
+            void sse(uint8_t prefix, uint8_t op, uint8_t xmm, const Operand& m) {
+                byte(prefix);
+                if (m.base == Base::Constants) {
+                    byte(0x41);
+                }
+                byte(0x0F);
+                byte(op);
+                memory(xmm, m);
+            }
+
+            // prefix 0F op /r  for two xmm registers
+            void sseRegisters(uint8_t prefix, uint8_t op, uint8_t dst, uint8_t src) {
+                byte(prefix);
+                byte(0x0F);
+                byte(op);
+                byte((uint8_t)(0xC0 | (dst << 3) | src));
+            }
+
+            // REX.W op /r  for rax and a memory operand
+            void gpr(uint8_t op, const Operand& m) {
+                byte(m.base == Base::Constants ? 0x49 : 0x48);
+                byte(op);
+                memory(0, m);
+            }
+        };
+
+        const uint8_t MOVSD_LOAD = 0x10;
+        const uint8_t MOVSD_STORE = 0x11;
+        const uint8_t SQRTSD = 0x51;
+        const uint8_t ANDPD = 0x54;
+        const uint8_t XORPD = 0x57;
+        const uint8_t ADDSD = 0x58;
+        const uint8_t MULSD = 0x59;
+        const uint8_t SUBSD = 0x5C;
+        const uint8_t DIVSD = 0x5E;
+        const uint8_t MAXSD = 0x5F;
+        const uint8_t CMPSD = 0xC2;
+
+        bool jitDisabledByEnvironment() {
+            const char* env = getenv("CALC_JIT");
+            return env && strcmp(env, "0") == 0;
+        }
+
+        // Called from generated code for OpCode::Power
+        double powFunction(double base, double exponent) {
+            return inline_::power(base, exponent);
+        }
+    }
+
+    bool JitExpression::available() {
+        static const bool enabled = !jitDisabledByEnvironment();
+        return enabled;
+    }
+
+    JitExpression::JitExpression(const Expression& expression)
+        : expression_(expression), function_(nullptr), memory_(nullptr), size_(0) {
+        if (!expression_.valid() || !available()) {
+            return;
+        }
+
+        size_t variableCount = expression_.variables().size();
+        size_t constantCount = expression_.constants().size();
+        size_t temporaryBase = variableCount + constantCount;
+        size_t temporaryCount = expression_.registerCount() > temporaryBase ? expression_.registerCount() - temporaryBase : 0;
+
+        // Entry rsp is 8 mod 16; two pushes keep it there, so the frame must be 8 mod 16
+        // for calls to pow to see an aligned stack.
+        uint32_t frame = (uint32_t)(temporaryCount * 8);
+        if (frame % 16 == 0) {
+            frame += 8;
+        }
+        if (frame > 0x7FFFFFF0u) {
+            return;
+        }
+
+        auto operand = [&](uint16_t reg) {
+            if (reg < variableCount) {
+                return Operand{Base::Values, (int32_t)(reg * 8)};
+            }
+            if (reg < temporaryBase) {
+                return Operand{Base::Constants, (int32_t)((reg - variableCount) * 8)};
+            }
+            return Operand{Base::Frame, (int32_t)((reg - temporaryBase) * 8)};
+        };
+
+        Assembler as;
+        as.byte(0x53);                                  // push rbx
+        as.byte(0x41); as.byte(0x55);                   // push r13
+        as.byte(0x48); as.byte(0x81); as.byte(0xEC);    // sub rsp, frame
+        as.bytes4(frame);
+        as.byte(0x48); as.byte(0x89); as.byte(0xFB);    // mov rbx, rdi
+        as.byte(0x49); as.byte(0xBD);                   // mov r13, imm64 (patched below)
+        size_t poolPatch = as.bytes.size();
+        as.bytes8(0);
+
+        // xmm0 caches the last value stored so chained operations skip a reload.
+        int cached = -1;
+        for (const Instruction& ins : expression_.code()) {
+            Operand a = operand(ins.a);
+            Operand b = operand(ins.b);
+            Operand dst = operand(ins.dst);
+            switch (ins.op) {
+                case OpCode::Neg:
+                    as.gpr(0x8B, a);                                                    // mov rax, [a]
+                    as.byte(0x48); as.byte(0x0F); as.byte(0xBA); as.byte(0xF8); as.byte(63); // btc rax, 63
+                    as.gpr(0x89, dst);                                                  // mov [dst], rax
+                    cached = -1;
+                    continue;
+                case OpCode::SquareRoot:
+                    // maxsd(+0, a) keeps NaN and -0 and maps negatives to +0, matching calc::squareRoot
+                    as.sseRegisters(0x66, XORPD, 1, 1);
+                    as.sse(0xF2, MAXSD, 1, a);
+                    as.sseRegisters(0xF2, SQRTSD, 0, 1);
+                    break;
+                case OpCode::Power:
+                    if (cached != ins.a) {
+                        as.sse(0xF2, MOVSD_LOAD, 0, a);
+                    }
+                    as.sse(0xF2, MOVSD_LOAD, 1, b);
+                    as.byte(0x48); as.byte(0xB8);                                       // mov rax, imm64
+                    as.bytes8((uint64_t)(uintptr_t)&powFunction);
+                    as.byte(0xFF); as.byte(0xD0);                                       // call rax
+                    break;
+                case OpCode::Divide:
+                    // Quotient masked to +0 where the divisor is zero, matching calc::divide
+                    if (cached != ins.a) {
+                        as.sse(0xF2, MOVSD_LOAD, 0, a);
+                    }
+                    as.sse(0xF2, MOVSD_LOAD, 1, b);
+                    as.sseRegisters(0xF2, DIVSD, 0, 1);
+                    as.sseRegisters(0x66, XORPD, 2, 2);
+                    as.sseRegisters(0xF2, CMPSD, 1, 2); as.byte(4);                     // cmpneqsd xmm1, xmm2
+                    as.sseRegisters(0x66, ANDPD, 0, 1);
+                    break;
+                default: {
+                    uint8_t op = ins.op == OpCode::Add ? ADDSD : ins.op == OpCode::Subtract ? SUBSD : MULSD;
+                    if (cached != ins.a) {
+                        as.sse(0xF2, MOVSD_LOAD, 0, a);
+                    }
+                    as.sse(0xF2, op, 0, b);
+                    break;
+                }
+            }
+            as.sse(0xF2, MOVSD_STORE, 0, dst);
+            cached = ins.dst;
+        }
+
+        if (cached != expression_.resultRegister()) {
+            as.sse(0xF2, MOVSD_LOAD, 0, operand(expression_.resultRegister()));
+        }
+        as.byte(0x48); as.byte(0x81); as.byte(0xC4);    // add rsp, frame
+        as.bytes4(frame);
+        as.byte(0x41); as.byte(0x5D);                   // pop r13
+        as.byte(0x5B);                                  // pop rbx
+        as.byte(0xC3);                                  // ret
+
+        size_t poolOffset = (as.bytes.size() + 15) & ~(size_t)15;
+        size_t total = poolOffset + constantCount * sizeof(double);
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t size = (total + page - 1) / page * page;
+
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return;
+        }
+        uint8_t* base = (uint8_t*)memory;
+        uint64_t pool = (uint64_t)(uintptr_t)(base + poolOffset);
+        memcpy(&as.bytes[poolPatch], &pool, sizeof(pool));
+        memcpy(base, as.bytes.data(), as.bytes.size());
+        if (constantCount) {
+            memcpy(base + poolOffset, expression_.constants().data(), constantCount * sizeof(double));
+        }
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, size);
+            return;
+        }
+        memory_ = memory;
+        size_ = size;
+        function_ = (Function)memory;
+    }
+
+    JitExpression::~JitExpression() {
+        if (memory_) {
+            munmap(memory_, size_);
+        }
+    }
+#else
+    bool JitExpression::available() {
+        return false;
+    }
+
+    JitExpression::JitExpression(const Expression& expression)
+        : expression_(expression), function_(nullptr), memory_(nullptr), size_(0) {
+    }
+
+    JitExpression::~JitExpression() {
+    }
+#endif
+}
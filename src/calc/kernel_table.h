@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "calc/cpu.h"
+#include "calc/kernels.h"
+#include "calc/reduce.h"
+
+namespace calc {
+namespace dispatch {
+    // value + error, with error holding the rounding errors of value
+    struct Compensated {
+        double value;
+        double error;
+    };
+
+    // Matrix product blocking: gemm packs GEMM_KC x GEMM_NC panels of b and GEMM_MC x
+    // GEMM_KC panels of a into the caller's workspace of GEMM_WORKSPACE doubles, sized
+    // so the b panel stays in L2 and the a panel in L1. The panel sizes are multiples of
+    // every build's register tile.
+    const size_t GEMM_MC = 64;
+    const size_t GEMM_KC = 256;
+    const size_t GEMM_NC = 512;
+    const size_t GEMM_WORKSPACE = GEMM_KC * (GEMM_NC + GEMM_MC);
+
+    // Batch operations for one element type.
+    template<typename T>
+    struct BatchTable {
+        void (*add)(const T* a, const T* b, T* out, size_t n);
+        void (*subtract)(const T* a, const T* b, T* out, size_t n);
+        void (*multiply)(const T* a, const T* b, T* out, size_t n);
+        void (*divide)(const T* a, const T* b, T* out, size_t n);
+        void (*squareRoot)(const T* values, T* out, size_t n);
+        void (*power)(const T* base, const T* exponent, T* out, size_t n);
+    };
+
+    // One instruction-set build of the batch operations and kernels (see kernels_impl.h).
+    struct Table {
+        Isa isa;
+
+        BatchTable<float> f32;
+        BatchTable<double> f64;
+        BatchTable<long double> f80;
+        BatchTable<int32_t> i32;
+        BatchTable<int64_t> i64;
+        uint64_t (*divideMasked)(const double* a, const double* b, double* out, size_t n, uint64_t* errorMask);
+        uint64_t (*squareRootMasked)(const double* values, double* out, size_t n, uint64_t* errorMask);
+
+        // Reductions over one chunk; extremum indices are relative to x
+        Compensated (*sum)(const double* x, size_t n);
+        Compensated (*dot)(const double* a, const double* b, size_t n);
+        Compensated (*product)(const double* x, size_t n);
+        Extremum (*minimum)(const double* x, size_t n);
+        Extremum (*maximum)(const double* x, size_t n);
+
+        // Polynomials, coefficients in ascending order (see calc/poly.h)
+        void (*polyval)(const double* coeffs, size_t degree, const double* x, double* out, size_t n);
+        double (*polyvalOne)(const double* coeffs, size_t degree, double x);
+        void (*chebval)(const double* coeffs, size_t degree, double lo, double hi, const double* x, double* out, size_t n);
+
+        // Row-major matrices with leading dimensions (see calc/matrix.h): c = a b for an
+        // m x k a and a k x n b, and y = a x for an m x n a
+        void (*gemm)(size_t m, size_t n, size_t k, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc, double* workspace);
+        void (*gemv)(size_t m, size_t n, const double* a, size_t lda, const double* x, double* y);
+
+        void (*sqrt)(const double* x, double* out, size_t n, Accuracy accuracy);
+        void (*rsqrt)(const double* x, double* out, size_t n, Accuracy accuracy);
+        void (*exp)(const double* x, double* out, size_t n, Accuracy accuracy);
+        void (*log)(const double* x, double* out, size_t n, Accuracy accuracy);
+        void (*sin)(const double* x, double* out, size_t n, Accuracy accuracy);
+        void (*cos)(const double* x, double* out, size_t n, Accuracy accuracy);
+        void (*pow)(const double* base, const double* exponent, double* out, size_t n, Accuracy accuracy);
+    };
+
+    extern const Table genericTable;
+#if CALC_DISPATCH_X86
+    extern const Table avx2Table;
+    extern const Table avx512Table;
+#endif
+
+    // The table for cpu::active(), resolved on first use.
+    const Table& table();
+
+    template<typename T> const BatchTable<T>& batch(const Table& t);
+    template<> inline const BatchTable<float>& batch(const Table& t) { return t.f32; }
+    template<> inline const BatchTable<double>& batch(const Table& t) { return t.f64; }
+    template<> inline const BatchTable<long double>& batch(const Table& t) { return t.f80; }
+    template<> inline const BatchTable<int32_t>& batch(const Table& t) { return t.i32; }
+    template<> inline const BatchTable<int64_t>& batch(const Table& t) { return t.i64; }
+
+    // The active table's batch operations for element type T.
+    template<typename T>
+    const BatchTable<T>& batch() {
+        return batch<T>(table());
+    }
+}
+}
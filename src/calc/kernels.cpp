@@ -0,0 +1,35 @@
+#include "calc/kernels.h"
+#include "kernel_table.h"
+
+// The kernels themselves live in kernels_impl.h, built once per instruction set.
+namespace calc {
+namespace kernels {
+    void sqrt(const double* x, double* out, size_t n, Accuracy accuracy) {
+        dispatch::table().sqrt(x, out, n, accuracy);
+    }
+
+    void rsqrt(const double* x, double* out, size_t n, Accuracy accuracy) {
+        dispatch::table().rsqrt(x, out, n, accuracy);
+    }
+
+    void exp(const double* x, double* out, size_t n, Accuracy accuracy) {
+        dispatch::table().exp(x, out, n, accuracy);
+    }
+
+    void log(const double* x, double* out, size_t n, Accuracy accuracy) {
+        dispatch::table().log(x, out, n, accuracy);
+    }
+
+    void sin(const double* x, double* out, size_t n, Accuracy accuracy) {
+        dispatch::table().sin(x, out, n, accuracy);
+    }
+
+    void cos(const double* x, double* out, size_t n, Accuracy accuracy) {
+        dispatch::table().cos(x, out, n, accuracy);
+    }
+
+    void pow(const double* base, const double* exponent, double* out, size_t n, Accuracy accuracy) {
+        dispatch::table().pow(base, exponent, out, n, accuracy);
+    }
+}
+}
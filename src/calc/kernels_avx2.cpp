@@ -0,0 +1,9 @@
+// Built with -mavx2 -mfma when CALC_DISPATCH_X86 is set; empty otherwise.
+#if CALC_DISPATCH_X86
+    #if !defined(__AVX2__) || !defined(__FMA__)
+        #error "kernels_avx2.cpp must be compiled with -mavx2 -mfma"
+    #endif
+    #define CALC_KERNELS_TABLE avx2Table
+    #define CALC_KERNELS_ISA Isa::Avx2
+    #include "kernels_impl.h"
+#endif
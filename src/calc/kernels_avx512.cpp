@@ -0,0 +1,9 @@
+// Built with -mavx512f -mavx512dq when CALC_DISPATCH_X86 is set; empty otherwise.
+#if CALC_DISPATCH_X86
+    #if !defined(__AVX512F__) || !defined(__AVX512DQ__)
+        #error "kernels_avx512.cpp must be compiled with -mavx512f -mavx512dq"
+    #endif
+    #define CALC_KERNELS_TABLE avx512Table
+    #define CALC_KERNELS_ISA Isa::Avx512
+    #include "kernels_impl.h"
+#endif
@@ -0,0 +1,3 @@
+#define CALC_KERNELS_TABLE genericTable
+#define CALC_KERNELS_ISA Isa::Generic
+#include "kernels_impl.h"
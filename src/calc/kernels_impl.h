@@ -0,0 +1,1096 @@
+#pragma once
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "element.h"
+#include "kernel_table.h"
+
+// Body of one instruction-set build of the batch operations and kernels.
+//
+// kernels_generic.cpp, kernels_avx2.cpp and kernels_avx512.cpp each define
+// CALC_KERNELS_TABLE and CALC_KERNELS_ISA, include this file and are compiled with
+// their own -m flags. Everything below has internal linkage: an out-of-line copy of
+// a helper from the AVX2 build must never be merged into the generic one, which is
+// also why element.h is used instead of calc::inline_, and why no std:: functions are
+// called.
+//
+// Every kernel is a straight loop over an inline, branch-free element function so the
+// compiler can vectorize it. Bits are moved between double and integer views with
+// memcpy, and integers are converted to and from doubles by adding a 1.5 * 2^52
+// shifter instead of using cvt instructions, which lack packed 64-bit forms before
+// AVX-512. Elements the fast path cannot handle are recomputed by libm in a second,
+// branchy but rarely taken, pass.
+//
+// Polynomial coefficients and argument reduction constants are from fdlibm.
+
+namespace calc {
+namespace dispatch {
+    namespace {
+        inline uint64_t bitsOf(double d) {
+            uint64_t u;
+            memcpy(&u, &d, sizeof(u));
+            return u;
+        }
+
+        inline double fromBits(uint64_t u) {
+            double d;
+            memcpy(&d, &u, sizeof(d));
+            return d;
+        }
+
+        // Adding SHIFTER to |v| < 2^51 rounds v to an integer held in the low mantissa bits.
+        const double SHIFTER = 6755399441055744.0;
+        const uint64_t SHIFTER_BITS = 0x4338000000000000ull;
+
+        const double LOG2E = 1.44269504088896338700e+00;
+        const double LN2_HI = 6.93147180369123816490e-01;
+        const double LN2_LO = 1.90821492927058770002e-10;
+
+        // 2^n for t = n + SHIFTER with n in [-1022, 1023].
+        inline double pow2Shifted(double t) {
+            return fromBits((bitsOf(t) - SHIFTER_BITS + 1023) << 52);
+        }
+
+        //=========================================================================
+        // exp
+        //=========================================================================
+
+        // a + b == sum + error exactly, for any magnitudes (Knuth).
+        inline double sumError(double a, double b, double sum) {
+            double bb = sum - a;
+            return (a - (sum - bb)) + (b - bb);
+        }
+
+        // exp(x + xlo) where xlo is a small correction below the precision of x.
+        template<bool Fast>
+        inline double expCore(double x, double xlo) {
+            // Clamping keeps 2^n representable as two normal factors; the clamped
+            // results still overflow to inf or underflow to 0.
+            x = x > 710.0 ? 710.0 : x;
+            x = x < -746.0 ? -746.0 : x;
+            double nd = (x * LOG2E + SHIFTER) - SHIFTER;
+            // r + rLo = x + xlo - nd*ln2; x - nd*LN2_HI is exact, and keeping the rounding
+            // error of r makes the reduction itself worth well under 0.1 ULP.
+            double t = x - nd * LN2_HI;
+            double u = xlo - nd * LN2_LO;
+            double r = t + u;
+            double rLo = sumError(t, u, r);
+
+            // Taylor series on |r| <= ln2/2: degree 13 stays below 1 ULP, degree 12 below 4.
+            double q;
+            if (Fast) {
+                q = 1.0 / 479001600;
+            } else {
+                q = 1.0 / 479001600 + r * (1.0 / 6227020800);
+            }
+            q = 1.0 / 39916800 + r * q;
+            q = 1.0 / 3628800 + r * q;
+            q = 1.0 / 362880 + r * q;
+            q = 1.0 / 40320 + r * q;
+            q = 1.0 / 5040 + r * q;
+            q = 1.0 / 720 + r * q;
+            q = 1.0 / 120 + r * q;
+            q = 1.0 / 24 + r * q;
+            q = 1.0 / 6 + r * q;
+            q = 0.5 + r * q;
+            double p = 1.0 + (r + (rLo + rLo * r + (r * r) * q));
+
+            // Scale by 2^n as 2^n1 * 2^n2 so subnormal results round only once.
+            double half = nd * 0.5 + SHIFTER;
+            double n1 = half - SHIFTER;
+            return (p * pow2Shifted(half)) * pow2Shifted((nd - n1) + SHIFTER);
+        }
+
+        //=========================================================================
+        // log
+        //=========================================================================
+
+        const double LG1 = 6.666666666666735130e-01;
+        const double LG2 = 3.999999999940941908e-01;
+        const double LG3 = 2.857142874366239149e-01;
+        const double LG4 = 2.222219843214978396e-01;
+        const double LG5 = 1.818357216161805012e-01;
+        const double LG6 = 1.531383769920937332e-01;
+        const double LG7 = 1.479819860511658591e-01;
+
+        // Splits positive finite x into 2^k * m with m in [sqrt(1/2), sqrt(2)).
+        inline void logReduce(double x, double& k, double& m) {
+            bool subnormal = x < 0x1p-1022;
+            double scaled = subnormal ? x * 0x1p54 : x;
+            uint64_t ix = bitsOf(scaled);
+            // Adding bits(1.0) - bits(sqrt(1/2)) moves the binade edge to sqrt(1/2)
+            uint64_t biased = (ix + 0x00095F619980C433ull) >> 52;   // k + 1023
+            m = fromBits(ix - ((biased - 1023) << 52));
+            k = (fromBits(SHIFTER_BITS + biased) - SHIFTER) - 1023.0 - (subnormal ? 54.0 : 0.0);
+        }
+
+        inline double logCore(double x) {
+            double k, m;
+            logReduce(x, k, m);
+            double f = m - 1.0;
+            double s = f / (2.0 + f);
+            double hfsq = 0.5 * f * f;
+            double z = s * s;
+            double w = z * z;
+            double R = w * (LG2 + w * (LG4 + w * LG6)) + z * (LG1 + w * (LG3 + w * (LG5 + w * LG7)));
+            return k * LN2_HI - ((hfsq - (s * (hfsq + R) + k * LN2_LO)) - f);
+        }
+
+        //=========================================================================
+        // pow
+        //=========================================================================
+
+        // Error-free product: a * b == p + e exactly. The error is exact either way, so the
+        // FMA and Dekker forms give identical results (barring overflow in the split).
+        inline double productError(double a, double b, double p) {
+#if defined(__FMA__)
+            return __builtin_fma(a, b, -p);
+#else
+            const double SPLIT = 134217729.0;   // 2^27 + 1
+            double ca = SPLIT * a;
+            double ah = ca - (ca - a);
+            double al = a - ah;
+            double cb = SPLIT * b;
+            double bh = cb - (cb - b);
+            double bl = b - bh;
+            return ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+#endif
+        }
+
+        const double TWO_THIRDS_HI = 6.66666666666666629659e-01;
+        const double TWO_THIRDS_LO = 3.70074341541718826e-17;
+        const double TWO_FIFTHS_HI = 4.00000000000000022204e-01;
+        const double TWO_FIFTHS_LO = -2.22044604925031320e-17;
+
+        // log(x) for positive finite x as logHi + logLo, accurate to about 2^-70 relative,
+        // which pow needs because |y| multiplies the absolute error of log(x).
+        //
+        // log(m) = 2s + (2/3)s^3 + (2/5)s^5 + ... with s = (m - 1) / (m + 1). The first three
+        // terms are carried in double-double and Taylor terms through s^25 reach the target
+        // on |s| <= 0.1716.
+        inline void logExtended(double x, double& logHi, double& logLo) {
+            double k, m;
+            logReduce(x, k, m);
+            double f = m - 1.0;
+
+            // s = f / (2 + f) as s + sLo
+            double d = 2.0 + f;
+            double dLo = f - (d - 2.0);
+            double s = f / d;
+            double sd = s * d;
+            double sLo = (((f - sd) - productError(s, d, sd)) - s * dLo) / d;
+
+            // (2/3)s^3 as third + thirdLo
+            double sq = s * s;
+            double sqLo = productError(s, s, sq);
+            double cube = sq * s;
+            double cubeLo = productError(sq, s, cube) + sqLo * s;
+            double third = cube * TWO_THIRDS_HI;
+            double thirdLo = productError(cube, TWO_THIRDS_HI, third) + cube * TWO_THIRDS_LO + cubeLo * TWO_THIRDS_HI;
+
+            // (2/5)s^5 as fifth + fifthLo
+            double s5 = cube * sq;
+            double s5Lo = productError(cube, sq, s5) + cubeLo * sq + cube * sqLo;
+            double fifth = s5 * TWO_FIFTHS_HI;
+            double fifthLo = productError(s5, TWO_FIFTHS_HI, fifth) + s5 * TWO_FIFTHS_LO + s5Lo * TWO_FIFTHS_HI;
+
+            // (2/7)s^7 + ... + (2/25)s^25 is below 1.3e-6, so doubles are enough
+            double z = sq;
+            double rest = 2.0 / 25;
+            rest = 2.0 / 23 + z * rest;
+            rest = 2.0 / 21 + z * rest;
+            rest = 2.0 / 19 + z * rest;
+            rest = 2.0 / 17 + z * rest;
+            rest = 2.0 / 15 + z * rest;
+            rest = 2.0 / 13 + z * rest;
+            rest = 2.0 / 11 + z * rest;
+            rest = 2.0 / 9 + z * rest;
+            rest = 2.0 / 7 + z * rest;
+            rest *= s5 * z;
+
+            // Sum from k*ln2 down, keeping each rounding error; the sLo terms are the
+            // first-order corrections of 2s, (2/3)s^3 and (2/5)s^5.
+            double a = k * LN2_HI;
+            double b = 2.0 * s;
+            double h1 = a + b;
+            double l1 = sumError(a, b, h1);
+            double h2 = h1 + third;
+            double l2 = sumError(h1, third, h2);
+            double h3 = h2 + fifth;
+            double l3 = sumError(h2, fifth, h3);
+            double lo = l1 + l2 + l3 + thirdLo + fifthLo + rest + 2.0 * sLo * (1.0 + sq + sq * sq) + k * LN2_LO;
+            logHi = h3 + lo;
+            logLo = lo - (logHi - h3);
+        }
+
+        // pow(x, y) = exp(y * log(x)), with y * log(x) formed in double-double. Needs x > 0
+        // finite and |y| < 2^900; anything else goes through the libm fix-up pass.
+        template<bool Fast>
+        inline double powCore(double x, double y) {
+            double logHi, logLo;
+            logExtended(x, logHi, logLo);
+            double product = y * logHi;
+            double productLo = productError(y, logHi, product) + y * logLo;
+            // Beyond the exp range the result is 0 or inf; drop a possibly non-finite correction
+            productLo = fabs(product) < 750.0 ? productLo : 0.0;
+            return expCore<Fast>(product, productLo);
+        }
+
+        //=========================================================================
+        // sin / cos
+        //=========================================================================
+
+        const double TWO_OVER_PI = 6.36619772367581382433e-01;
+        const double PIO2_1 = 1.57079632673412561417e+00;   // first 33 bits of pi/2
+        const double PIO2_2 = 6.07710050630396597660e-11;   // next 33 bits
+        const double PIO2_3 = 2.02226624871116645580e-21;   // next 33 bits
+        const double PIO2_3T = 8.47842766036889956997e-32;  // pi/2 - (PIO2_1 + PIO2_2 + PIO2_3)
+        const double TRIG_LIMIT = 1e5;                       // k * PIO2_n stays exact below this
+
+        const double S1 = -1.66666666666666324348e-01;
+        const double S2 = 8.33333333332248946124e-03;
+        const double S3 = -1.98412698298579493134e-04;
+        const double S4 = 2.75573137070700676789e-06;
+        const double S5 = -2.50507602534068634195e-08;
+        const double S6 = 1.58969099521155010221e-10;
+
+        const double C1 = 4.16666666666666019037e-02;
+        const double C2 = -1.38888888888741095749e-03;
+        const double C3 = 2.48015872894767294178e-05;
+        const double C4 = -2.75573143513906633035e-07;
+        const double C5 = 2.08757232129817482790e-09;
+        const double C6 = -1.13596475577881948265e-11;
+
+        // Reduces x to r + rLo in [-pi/4, pi/4]; returns the quadrant in the low two bits.
+        template<bool Fast>
+        inline uint64_t trigReduce(double x, double& r, double& rLo) {
+            double t = x * TWO_OVER_PI + SHIFTER;
+            double k = t - SHIFTER;
+            double r1 = x - k * PIO2_1;
+            double w = k * PIO2_2;
+            double r2 = r1 - w;
+            if (Fast) {
+                r = r2 - (k * PIO2_3 + k * PIO2_3T);
+                rLo = 0.0;
+            } else {
+                // Exact error of r1 - w, then fold in the remaining bits of pi/2
+                double bb = r2 - r1;
+                double err = (r1 - (r2 - bb)) - (w + bb);
+                double c = err - (k * PIO2_3 + k * PIO2_3T);
+                r = r2 + c;
+                rLo = c - (r - r2);
+            }
+            return bitsOf(t);
+        }
+
+        inline double sinKernel(double x, double y) {
+            double z = x * x;
+            double v = z * x;
+            double r = S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)));
+            return x - ((z * (0.5 * y - v * r) - y) - v * S1);
+        }
+
+        inline double cosKernel(double x, double y) {
+            double z = x * x;
+            double r = z * (C1 + z * (C2 + z * (C3 + z * (C4 + z * (C5 + z * C6)))));
+            double hz = 0.5 * z;
+            double w = 1.0 - hz;
+            return w + (((1.0 - w) - hz) + (z * r - x * y));
+        }
+
+        // sin(x) for Phase 0 and cos(x) for Phase 1 (cos x = sin(x + pi/2)).
+        template<bool Fast, uint64_t Phase>
+        inline double sinCosCore(double x) {
+            double r, rLo;
+            uint64_t quadrant = trigReduce<Fast>(x, r, rLo) + Phase;
+            double s = sinKernel(r, rLo);
+            double c = cosKernel(r, rLo);
+            // Bitwise select: SSE2 has no packed 64-bit integer compare to drive a blend
+            uint64_t pickCos = 0 - (quadrant & 1);
+            uint64_t v = (bitsOf(c) & pickCos) | (bitsOf(s) & ~pickCos);
+            return fromBits(v ^ ((quadrant & 2) << 62));
+        }
+
+        const size_t BLOCK = 256;
+
+        // Runs the vector pass into a stack block, then lets libm redo the elements the
+        // pass cannot handle. Going through the block keeps the fix-up reading the
+        // original inputs when out aliases x.
+        template<typename Vector, typename Unsupported, typename Fallback>
+        inline void unaryBlocks(const double* x, double* out, size_t n, Vector vector, Unsupported unsupported, Fallback fallback) {
+            double block[BLOCK];
+            for (size_t start = 0; start < n; start += BLOCK) {
+                size_t count = n - start < BLOCK ? n - start : BLOCK;
+                const double* in = x + start;
+                for (size_t i = 0; i < count; i++) {
+                    block[i] = vector(in[i]);
+                }
+                for (size_t i = 0; i < count; i++) {
+                    if (unsupported(in[i])) {
+                        block[i] = fallback(in[i]);
+                    }
+                }
+                memcpy(out + start, block, count * sizeof(double));
+            }
+        }
+
+        template<typename Vector, typename Unsupported, typename Fallback>
+        inline void binaryBlocks(const double* x, const double* y, double* out, size_t n, Vector vector, Unsupported unsupported, Fallback fallback) {
+            double block[BLOCK];
+            for (size_t start = 0; start < n; start += BLOCK) {
+                size_t count = n - start < BLOCK ? n - start : BLOCK;
+                const double* a = x + start;
+                const double* b = y + start;
+                for (size_t i = 0; i < count; i++) {
+                    block[i] = vector(a[i], b[i]);
+                }
+                for (size_t i = 0; i < count; i++) {
+                    if (unsupported(a[i], b[i])) {
+                        block[i] = fallback(a[i], b[i]);
+                    }
+                }
+                memcpy(out + start, block, count * sizeof(double));
+            }
+        }
+
+        inline bool logUnsupported(double x) {
+            return !(x > 0 && x < INFINITY);
+        }
+
+        inline bool trigUnsupported(double x) {
+            return !(fabs(x) <= TRIG_LIMIT);
+        }
+
+        inline bool powUnsupported(double x, double y) {
+            return !(x > 0 && x < INFINITY && fabs(y) < 0x1p900);
+        }
+
+        template<bool Fast, uint64_t Phase>
+        void sinCosBlocks(const double* x, double* out, size_t n) {
+            unaryBlocks(x, out, n,
+                [](double v) { return sinCosCore<Fast, Phase>(v); },
+                trigUnsupported,
+                [](double v) { return Phase ? ::cos(v) : ::sin(v); });
+        }
+
+        template<bool Fast>
+        void powBlocks(const double* base, const double* exponent, double* out, size_t n) {
+            binaryBlocks(base, exponent, out, n,
+                [](double x, double y) { return powCore<Fast>(x > 0 ? x : 1.0, y); },
+                powUnsupported,
+                [](double x, double y) { return ::pow(x, y); });
+        }
+
+        //=========================================================================
+        // Batch operations
+        //=========================================================================
+        // Per-element rules are in element.h.
+
+        template<typename T>
+        void addBatch(const T* a, const T* b, T* out, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                out[i] = element::add(a[i], b[i]);
+            }
+        }
+
+        template<typename T>
+        void subtractBatch(const T* a, const T* b, T* out, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                out[i] = element::subtract(a[i], b[i]);
+            }
+        }
+
+        template<typename T>
+        void multiplyBatch(const T* a, const T* b, T* out, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                out[i] = element::multiply(a[i], b[i]);
+            }
+        }
+
+        template<typename T>
+        void divideBatch(const T* a, const T* b, T* out, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                out[i] = element::divide(a[i], b[i]);
+            }
+        }
+
+        template<typename T>
+        void squareRootBatch(const T* values, T* out, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                out[i] = element::squareRoot(values[i]);
+            }
+        }
+
+        // base^n for a floating-point base and an integer exponent shared by every
+        // element, with the results of element::power: the same squaring chain, run one
+        // bit of n at a time over a block so each step is a vector loop, then pow() for
+        // results outside the normal range.
+        template<typename T>
+        void powerInteger(const T* base, int n, T* out, size_t count) {
+            if (n == 2) {
+                for (size_t i = 0; i < count; i++) {
+                    out[i] = base[i] * base[i];
+                }
+                return;
+            }
+            unsigned bits = (unsigned)(n < 0 ? -n : n);
+            T result[BLOCK];
+            T square[BLOCK];
+            for (size_t start = 0; start < count; start += BLOCK) {
+                size_t m = count - start < BLOCK ? count - start : BLOCK;
+                const T* in = base + start;
+                for (size_t i = 0; i < m; i++) {
+                    result[i] = 1;
+                    square[i] = in[i];
+                }
+                for (unsigned rest = bits; rest; rest >>= 1) {
+                    if (rest & 1) {
+                        for (size_t i = 0; i < m; i++) {
+                            result[i] *= square[i];
+                        }
+                    }
+                    if (rest > 1) {
+                        for (size_t i = 0; i < m; i++) {
+                            square[i] *= square[i];
+                        }
+                    }
+                }
+                for (size_t i = 0; i < m; i++) {
+                    if (!element::isNormal(result[i])) {
+                        result[i] = element::raise(in[i], (T)n);
+                    } else if (n < 0) {
+                        result[i] = 1 / result[i];
+                    }
+                }
+                memcpy(out + start, result, m * sizeof(T));
+            }
+        }
+
+        template<typename T>
+        void powerBatch(const T* base, const T* exponent, T* out, size_t n) {
+            if constexpr (!std::is_integral<T>::value) {
+                // A shared small integer exponent runs as vectorized multiplication chains
+                if (n > 0) {
+                    T e = exponent[0];
+                    bool uniform = element::absolute(e) <= element::POWER_CHAIN_LIMIT && e == (T)(int)e;
+                    for (size_t i = 1; uniform && i < n; i++) {
+                        uniform = exponent[i] == e;
+                    }
+                    if (uniform) {
+                        powerInteger(base, (int)e, out, n);
+                        return;
+                    }
+                }
+            }
+            for (size_t i = 0; i < n; i++) {
+                out[i] = element::power(base[i], exponent[i]);
+            }
+        }
+
+        template<typename T>
+        constexpr BatchTable<T> batchTable() {
+            return BatchTable<T>{addBatch<T>, subtractBatch<T>, multiplyBatch<T>, divideBatch<T>, squareRootBatch<T>, powerBatch<T>};
+        }
+
+        // Results and mask bits are produced in blocks of 64 so each mask word is built
+        // from a short branch-free loop. Returns the OR of all mask words.
+        uint64_t divideMasked(const double* a, const double* b, double* out, size_t n, uint64_t* errorMask) {
+            uint64_t any = 0;
+            for (size_t base = 0; base < n; base += 64) {
+                size_t count = n - base < 64 ? n - base : 64;
+                uint64_t bits = 0;
+                for (size_t j = 0; j < count; j++) {
+                    double d = b[base + j];
+                    out[base + j] = element::divide(a[base + j], d);
+                    bits |= (uint64_t)(d == 0) << j;
+                }
+                errorMask[base / 64] = bits;
+                any |= bits;
+            }
+            return any;
+        }
+
+        uint64_t squareRootMasked(const double* values, double* out, size_t n, uint64_t* errorMask) {
+            uint64_t any = 0;
+            for (size_t base = 0; base < n; base += 64) {
+                size_t count = n - base < 64 ? n - base : 64;
+                uint64_t bits = 0;
+                for (size_t j = 0; j < count; j++) {
+                    double v = values[base + j];
+                    out[base + j] = element::squareRoot(v);
+                    bits |= (uint64_t)(v < 0) << j;
+                }
+                errorMask[base / 64] = bits;
+                any |= bits;
+            }
+            return any;
+        }
+
+        //=========================================================================
+        // Reductions
+        //=========================================================================
+        // Element i goes to lane i % LANES, and each lane keeps its own compensated
+        // accumulator, so the loops vectorize and results depend only on the input.
+
+        const size_t LANES = 8;
+        const size_t NOT_FOUND = (size_t)-1;
+
+        // s + x == s' + (rounding error), accumulated into c (Knuth's TwoSum)
+        inline void addCompensated(double& s, double& c, double x) {
+            double t = s + x;
+            double bb = t - s;
+            c += (s - (t - bb)) + (x - bb);
+            s = t;
+        }
+
+        // An infinity or an overflow turns the error terms into inf - inf (and the
+        // non-FMA productError's split overflows near DBL_MAX); dropping a non-finite
+        // error lets the plain IEEE value, such as +-inf, through instead of NaN.
+        inline Compensated settle(Compensated r) {
+            const uint64_t EXPONENT = 0x7FF0000000000000ull;
+            if ((bitsOf(r.value) & EXPONENT) == EXPONENT || (bitsOf(r.error) & EXPONENT) == EXPONENT) {
+                r.error = 0.0;
+            }
+            return r;
+        }
+
+        inline Compensated foldLanes(const double* s, const double* c) {
+            Compensated r = {0.0, 0.0};
+            for (size_t j = 0; j < LANES; j++) {
+                r.error += c[j];
+                addCompensated(r.value, r.error, s[j]);
+            }
+            return settle(r);
+        }
+
+        Compensated sumChunk(const double* x, size_t n) {
+            double s[LANES] = {};
+            double c[LANES] = {};
+            size_t i = 0;
+            for (; i + LANES <= n; i += LANES) {
+                for (size_t j = 0; j < LANES; j++) {
+                    addCompensated(s[j], c[j], x[i + j]);
+                }
+            }
+            for (; i < n; i++) {
+                addCompensated(s[i % LANES], c[i % LANES], x[i]);
+            }
+            return foldLanes(s, c);
+        }
+
+        Compensated dotChunk(const double* a, const double* b, size_t n) {
+            double s[LANES] = {};
+            double c[LANES] = {};
+            size_t i = 0;
+            for (; i + LANES <= n; i += LANES) {
+                for (size_t j = 0; j < LANES; j++) {
+                    double p = a[i + j] * b[i + j];
+                    c[j] += productError(a[i + j], b[i + j], p);
+                    addCompensated(s[j], c[j], p);
+                }
+            }
+            for (; i < n; i++) {
+                double p = a[i] * b[i];
+                c[i % LANES] += productError(a[i], b[i], p);
+                addCompensated(s[i % LANES], c[i % LANES], p);
+            }
+            return foldLanes(s, c);
+        }
+
+        // (p1 + e1) * (p2 + e2) with the rounding error of p1 * p2 kept
+        inline Compensated multiplyCompensated(Compensated x, Compensated y) {
+            double p = x.value * y.value;
+            double e = productError(x.value, y.value, p) + (x.value * y.error + x.error * y.value);
+            return Compensated{p, e};
+        }
+
+        Compensated productChunk(const double* x, size_t n) {
+            double p[LANES];
+            double e[LANES];
+            for (size_t j = 0; j < LANES; j++) {
+                p[j] = 1.0;
+                e[j] = 0.0;
+            }
+            size_t i = 0;
+            for (; i + LANES <= n; i += LANES) {
+                for (size_t j = 0; j < LANES; j++) {
+                    double q = p[j] * x[i + j];
+                    e[j] = e[j] * x[i + j] + productError(p[j], x[i + j], q);
+                    p[j] = q;
+                }
+            }
+            for (; i < n; i++) {
+                size_t j = i % LANES;
+                double q = p[j] * x[i];
+                e[j] = e[j] * x[i] + productError(p[j], x[i], q);
+                p[j] = q;
+            }
+            Compensated r = {1.0, 0.0};
+            for (size_t j = 0; j < LANES; j++) {
+                r = multiplyCompensated(r, Compensated{p[j], e[j]});
+            }
+            return settle(r);
+        }
+
+        // The lowest-index minimum (Less) or maximum (!Less), skipping NaNs
+        template<bool Less>
+        Extremum extremumChunk(const double* x, size_t n) {
+            double value[LANES];
+            size_t index[LANES];
+            for (size_t j = 0; j < LANES; j++) {
+                value[j] = NAN;
+                index[j] = NOT_FOUND;
+            }
+            size_t i = 0;
+            for (; i + LANES <= n; i += LANES) {
+                for (size_t j = 0; j < LANES; j++) {
+                    double v = x[i + j];
+                    bool better = Less ? v < value[j] : v > value[j];
+                    bool take = better || (index[j] == NOT_FOUND && v == v);
+                    value[j] = take ? v : value[j];
+                    index[j] = take ? i + j : index[j];
+                }
+            }
+            for (; i < n; i++) {
+                size_t j = i % LANES;
+                double v = x[i];
+                if ((Less ? v < value[j] : v > value[j]) || (index[j] == NOT_FOUND && v == v)) {
+                    value[j] = v;
+                    index[j] = i;
+                }
+            }
+            Extremum r = {NAN, NOT_FOUND};
+            for (size_t j = 0; j < LANES; j++) {
+                if (index[j] == NOT_FOUND) {
+                    continue;
+                }
+                bool better = Less ? value[j] < r.value : value[j] > r.value;
+                if (r.index == NOT_FOUND || better || (value[j] == r.value && index[j] < r.index)) {
+                    r = Extremum{value[j], index[j]};
+                }
+            }
+            return r;
+        }
+
+        //=========================================================================
+        // Polynomials
+        //=========================================================================
+        // Coefficients are in ascending order. Arrays are evaluated a few groups of
+        // POLY_LANES elements at a time, each element with its own Horner or Clenshaw
+        // chain, so the chains fill the SIMD lanes and hide the multiply-add latency.
+        // Every element goes through the same operations wherever it sits in the array.
+
+#if defined(__FMA__) || defined(__aarch64__)
+        inline double multiplyAdd(double a, double b, double c) {
+            return __builtin_fma(a, b, c);
+        }
+#else
+        inline double multiplyAdd(double a, double b, double c) {
+            return a * b + c;
+        }
+#endif
+
+        const size_t POLY_LANES = 8;
+
+        inline double hornerOne(const double* c, size_t degree, double x) {
+            double r = c[degree];
+            for (size_t k = degree; k-- > 0;) {
+                r = multiplyAdd(r, x, c[k]);
+            }
+            return r;
+        }
+
+        inline void hornerLanes(double* acc, const double* x, double c) {
+            for (size_t j = 0; j < POLY_LANES; j++) {
+                acc[j] = multiplyAdd(acc[j], x[j], c);
+            }
+        }
+
+        // Four groups of lanes keep enough independent chains in flight to cover the
+        // multiply-add latency while still fitting in registers.
+        void polyvalBatch(const double* c, size_t degree, const double* x, double* out, size_t n) {
+            const size_t STEP = 4 * POLY_LANES;
+            size_t i = 0;
+            for (; i + STEP <= n; i += STEP) {
+                double a0[POLY_LANES], a1[POLY_LANES], a2[POLY_LANES], a3[POLY_LANES];
+                for (size_t j = 0; j < POLY_LANES; j++) {
+                    a0[j] = a1[j] = a2[j] = a3[j] = c[degree];
+                }
+                for (size_t k = degree; k-- > 0;) {
+                    hornerLanes(a0, x + i, c[k]);
+                    hornerLanes(a1, x + i + POLY_LANES, c[k]);
+                    hornerLanes(a2, x + i + 2 * POLY_LANES, c[k]);
+                    hornerLanes(a3, x + i + 3 * POLY_LANES, c[k]);
+                }
+                for (size_t j = 0; j < POLY_LANES; j++) {
+                    out[i + j] = a0[j];
+                    out[i + POLY_LANES + j] = a1[j];
+                    out[i + 2 * POLY_LANES + j] = a2[j];
+                    out[i + 3 * POLY_LANES + j] = a3[j];
+                }
+            }
+            for (; i < n; i++) {
+                out[i] = hornerOne(c, degree, x[i]);
+            }
+        }
+
+        // Estrin's scheme: pairs of coefficients are combined with x, then pairs of those
+        // with x^2, x^4, ..., so a single value has a dependency chain of log2(degree)
+        // steps instead of degree.
+        double polyvalOne(const double* c, size_t degree, double x) {
+            const size_t LIMIT = 64;
+            if (degree >= LIMIT) {
+                return hornerOne(c, degree, x);
+            }
+            double p[LIMIT];
+            size_t m = degree + 1;
+            const double* in = c;
+            double y = x;
+            while (m > 1) {
+                size_t half = m / 2;
+                for (size_t k = 0; k < half; k++) {
+                    p[k] = multiplyAdd(in[2 * k + 1], y, in[2 * k]);
+                }
+                if (m & 1) {
+                    p[half] = in[m - 1];
+                }
+                in = p;
+                m = (m + 1) / 2;
+                y *= y;
+            }
+            return in[0];
+        }
+
+        // Maps [lo, hi] onto [-1, 1] symmetrically, so both ends land exactly.
+        inline double chebyshevArgument(double x, double lo, double hi) {
+            return ((x - lo) - (hi - x)) / (hi - lo);
+        }
+
+        inline double clenshawOne(const double* c, size_t degree, double t) {
+            double b1 = 0.0;
+            double b2 = 0.0;
+            double twoT = 2.0 * t;
+            for (size_t k = degree; k >= 1; k--) {
+                double b0 = multiplyAdd(twoT, b1, c[k] - b2);
+                b2 = b1;
+                b1 = b0;
+            }
+            return multiplyAdd(t, b1, c[0] - b2);
+        }
+
+        inline void clenshawLanes(double* b1, double* b2, const double* twoT, double c) {
+            for (size_t j = 0; j < POLY_LANES; j++) {
+                double b0 = multiplyAdd(twoT[j], b1[j], c - b2[j]);
+                b2[j] = b1[j];
+                b1[j] = b0;
+            }
+        }
+
+        inline void clenshawFinish(double* out, const double* b1, const double* b2, const double* twoT, double c) {
+            for (size_t j = 0; j < POLY_LANES; j++) {
+                out[j] = multiplyAdd(0.5 * twoT[j], b1[j], c - b2[j]);
+            }
+        }
+
+        // Clenshaw's recurrence for sum c[k] T_k(t): on [-1, 1] every intermediate stays
+        // within the sum of |c[k]|, so it neither overflows nor loses accuracy the way
+        // expanding into monomials does.
+        void chebvalBatch(const double* c, size_t degree, double lo, double hi, const double* x, double* out, size_t n) {
+            const size_t STEP = 2 * POLY_LANES;
+            size_t i = 0;
+            for (; i + STEP <= n; i += STEP) {
+                double t0[POLY_LANES], b10[POLY_LANES], b20[POLY_LANES];
+                double t1[POLY_LANES], b11[POLY_LANES], b21[POLY_LANES];
+                for (size_t j = 0; j < POLY_LANES; j++) {
+                    t0[j] = 2.0 * chebyshevArgument(x[i + j], lo, hi);
+                    t1[j] = 2.0 * chebyshevArgument(x[i + POLY_LANES + j], lo, hi);
+                    b10[j] = b20[j] = b11[j] = b21[j] = 0.0;
+                }
+                for (size_t k = degree; k >= 1; k--) {
+                    clenshawLanes(b10, b20, t0, c[k]);
+                    clenshawLanes(b11, b21, t1, c[k]);
+                }
+                clenshawFinish(out + i, b10, b20, t0, c[0]);
+                clenshawFinish(out + i + POLY_LANES, b11, b21, t1, c[0]);
+            }
+            for (; i < n; i++) {
+                out[i] = clenshawOne(c, degree, chebyshevArgument(x[i], lo, hi));
+            }
+        }
+
+        //=========================================================================
+        // Matrix products
+        //=========================================================================
+        // gemm follows the usual packed layout: panels of b and a are copied into
+        // contiguous strips GEMM_NR columns wide and GEMM_MR rows tall (zero-padded at the
+        // edges), and a register tile of GEMM_MR x GEMM_NR sums runs down the shared
+        // dimension of one strip pair. Every element of c is summed in the same order
+        // whatever its position, so results never depend on how rows are split up.
+        //
+        // The tile is four rows of one, two or four vectors, whichever gives each build
+        // enough independent accumulators without spilling them.
+
+        const size_t GEMM_MR = 4;
+#if defined(__AVX512F__)
+        const size_t GEMM_NR = 16;
+#elif defined(__AVX2__)
+        const size_t GEMM_NR = 8;
+#else
+        const size_t GEMM_NR = 4;
+#endif
+
+        inline void gemmLanes(double* acc, double a, const double* b) {
+            for (size_t j = 0; j < GEMM_NR; j++) {
+                acc[j] = multiplyAdd(a, b[j], acc[j]);
+            }
+        }
+
+        // tile = the GEMM_MR x GEMM_NR product of one packed strip of a and one of b
+        inline void gemmTile(size_t kc, const double* a, const double* b, double* tile) {
+            double c0[GEMM_NR] = {}, c1[GEMM_NR] = {}, c2[GEMM_NR] = {}, c3[GEMM_NR] = {};
+            for (size_t p = 0; p < kc; p++) {
+                gemmLanes(c0, a[0], b);
+                gemmLanes(c1, a[1], b);
+                gemmLanes(c2, a[2], b);
+                gemmLanes(c3, a[3], b);
+                a += GEMM_MR;
+                b += GEMM_NR;
+            }
+            for (size_t j = 0; j < GEMM_NR; j++) {
+                tile[j] = c0[j];
+                tile[GEMM_NR + j] = c1[j];
+                tile[2 * GEMM_NR + j] = c2[j];
+                tile[3 * GEMM_NR + j] = c3[j];
+            }
+        }
+
+        void packB(size_t kc, size_t nc, const double* b, size_t ldb, double* out) {
+            for (size_t s = 0; s < nc; s += GEMM_NR) {
+                size_t width = nc - s < GEMM_NR ? nc - s : GEMM_NR;
+                for (size_t p = 0; p < kc; p++) {
+                    const double* row = b + p * ldb + s;
+                    for (size_t j = 0; j < GEMM_NR; j++) {
+                        out[j] = j < width ? row[j] : 0.0;
+                    }
+                    out += GEMM_NR;
+                }
+            }
+        }
+
+        void packA(size_t mc, size_t kc, const double* a, size_t lda, double* out) {
+            for (size_t s = 0; s < mc; s += GEMM_MR) {
+                size_t height = mc - s < GEMM_MR ? mc - s : GEMM_MR;
+                for (size_t p = 0; p < kc; p++) {
+                    for (size_t i = 0; i < GEMM_MR; i++) {
+                        out[i] = i < height ? a[(s + i) * lda + p] : 0.0;
+                    }
+                    out += GEMM_MR;
+                }
+            }
+        }
+
+        void gemm(size_t m, size_t n, size_t k, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc, double* workspace) {
+            if (k == 0) {
+                for (size_t i = 0; i < m; i++) {
+                    for (size_t j = 0; j < n; j++) {
+                        c[i * ldc + j] = 0.0;
+                    }
+                }
+                return;
+            }
+            double* packedB = workspace;
+            double* packedA = workspace + GEMM_KC * GEMM_NC;
+            double tile[GEMM_MR * GEMM_NR];
+            for (size_t jc = 0; jc < n; jc += GEMM_NC) {
+                size_t nc = n - jc < GEMM_NC ? n - jc : GEMM_NC;
+                for (size_t pc = 0; pc < k; pc += GEMM_KC) {
+                    size_t kc = k - pc < GEMM_KC ? k - pc : GEMM_KC;
+                    packB(kc, nc, b + pc * ldb + jc, ldb, packedB);
+                    for (size_t ic = 0; ic < m; ic += GEMM_MC) {
+                        size_t mc = m - ic < GEMM_MC ? m - ic : GEMM_MC;
+                        packA(mc, kc, a + ic * lda + pc, lda, packedA);
+                        for (size_t jr = 0; jr < nc; jr += GEMM_NR) {
+                            size_t width = nc - jr < GEMM_NR ? nc - jr : GEMM_NR;
+                            for (size_t ir = 0; ir < mc; ir += GEMM_MR) {
+                                size_t height = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+                                gemmTile(kc, packedA + ir * kc, packedB + jr * kc, tile);
+                                double* out = c + (ic + ir) * ldc + jc + jr;
+                                for (size_t i = 0; i < height; i++) {
+                                    for (size_t j = 0; j < width; j++) {
+                                        double v = tile[i * GEMM_NR + j];
+                                        out[i * ldc + j] = pc == 0 ? v : out[i * ldc + j] + v;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // Eight lanes in every build, so the order of each row's sum is the same at every
+        // level.
+        const size_t GEMV_LANES = 8;
+
+        inline void gemvLanes(double* acc, const double* a, const double* x) {
+            for (size_t j = 0; j < GEMV_LANES; j++) {
+                acc[j] = multiplyAdd(a[j], x[j], acc[j]);
+            }
+        }
+
+        // Column j of the tail goes to lane j, then the lanes are added pairwise
+        inline double gemvFinish(double* acc, const double* a, const double* x, size_t start, size_t n) {
+            for (size_t j = start; j < n; j++) {
+                acc[j - start] = multiplyAdd(a[j], x[j], acc[j - start]);
+            }
+            return ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+        }
+
+        // Four rows at a time share each load of x; a row left over runs the same
+        // operations on its own.
+        void gemv(size_t m, size_t n, const double* a, size_t lda, const double* x, double* y) {
+            size_t full = n - n % GEMV_LANES;
+            size_t i = 0;
+            for (; i + 4 <= m; i += 4) {
+                const double* a0 = a + i * lda;
+                const double* a1 = a0 + lda;
+                const double* a2 = a1 + lda;
+                const double* a3 = a2 + lda;
+                double s0[GEMV_LANES] = {}, s1[GEMV_LANES] = {}, s2[GEMV_LANES] = {}, s3[GEMV_LANES] = {};
+                for (size_t j = 0; j < full; j += GEMV_LANES) {
+                    gemvLanes(s0, a0 + j, x + j);
+                    gemvLanes(s1, a1 + j, x + j);
+                    gemvLanes(s2, a2 + j, x + j);
+                    gemvLanes(s3, a3 + j, x + j);
+                }
+                y[i] = gemvFinish(s0, a0, x, full, n);
+                y[i + 1] = gemvFinish(s1, a1, x, full, n);
+                y[i + 2] = gemvFinish(s2, a2, x, full, n);
+                y[i + 3] = gemvFinish(s3, a3, x, full, n);
+            }
+            for (; i < m; i++) {
+                const double* row = a + i * lda;
+                double s[GEMV_LANES] = {};
+                for (size_t j = 0; j < full; j += GEMV_LANES) {
+                    gemvLanes(s, row + j, x + j);
+                }
+                y[i] = gemvFinish(s, row, x, full, n);
+            }
+        }
+
+        //=========================================================================
+        // Kernel entry points
+        //=========================================================================
+
+        void sqrt(const double* x, double* out, size_t n, Accuracy) {
+            // Hardware square root is correctly rounded, so every tier shares it.
+            for (size_t i = 0; i < n; i++) {
+                out[i] = ::sqrt(x[i]);
+            }
+        }
+
+        void rsqrt(const double* x, double* out, size_t n, Accuracy) {
+            // Two correctly rounded operations: within 1 ULP in every tier.
+            for (size_t i = 0; i < n; i++) {
+                out[i] = 1.0 / ::sqrt(x[i]);
+            }
+        }
+
+        void exp(const double* x, double* out, size_t n, Accuracy accuracy) {
+            // Out-of-range and NaN inputs need no fix-up: clamping yields inf, 0 or NaN.
+            switch (accuracy) {
+                case Accuracy::Reference:
+                    for (size_t i = 0; i < n; i++) {
+                        out[i] = ::exp(x[i]);
+                    }
+                    break;
+                case Accuracy::Ulp1:
+                    for (size_t i = 0; i < n; i++) {
+                        out[i] = expCore<false>(x[i], 0.0);
+                    }
+                    break;
+                case Accuracy::Fast:
+                    for (size_t i = 0; i < n; i++) {
+                        out[i] = expCore<true>(x[i], 0.0);
+                    }
+                    break;
+            }
+        }
+
+        void log(const double* x, double* out, size_t n, Accuracy accuracy) {
+            if (accuracy == Accuracy::Reference) {
+                for (size_t i = 0; i < n; i++) {
+                    out[i] = ::log(x[i]);
+                }
+                return;
+            }
+            // One polynomial serves both vector tiers; it is already within 1 ULP.
+            unaryBlocks(x, out, n,
+                [](double v) { return logCore(v > 0 ? v : 1.0); },
+                logUnsupported,
+                [](double v) { return ::log(v); });
+        }
+
+        void sin(const double* x, double* out, size_t n, Accuracy accuracy) {
+            switch (accuracy) {
+                case Accuracy::Reference:
+                    for (size_t i = 0; i < n; i++) {
+                        out[i] = ::sin(x[i]);
+                    }
+                    break;
+                case Accuracy::Ulp1:
+                    sinCosBlocks<false, 0>(x, out, n);
+                    break;
+                case Accuracy::Fast:
+                    sinCosBlocks<true, 0>(x, out, n);
+                    break;
+            }
+        }
+
+        void cos(const double* x, double* out, size_t n, Accuracy accuracy) {
+            switch (accuracy) {
+                case Accuracy::Reference:
+                    for (size_t i = 0; i < n; i++) {
+                        out[i] = ::cos(x[i]);
+                    }
+                    break;
+                case Accuracy::Ulp1:
+                    sinCosBlocks<false, 1>(x, out, n);
+                    break;
+                case Accuracy::Fast:
+                    sinCosBlocks<true, 1>(x, out, n);
+                    break;
+            }
+        }
+
+        void pow(const double* base, const double* exponent, double* out, size_t n, Accuracy accuracy) {
+            switch (accuracy) {
+                case Accuracy::Reference:
+                    for (size_t i = 0; i < n; i++) {
+                        out[i] = ::pow(base[i], exponent[i]);
+                    }
+                    break;
+                case Accuracy::Ulp1:
+                    powBlocks<false>(base, exponent, out, n);
+                    break;
+                case Accuracy::Fast:
+                    powBlocks<true>(base, exponent, out, n);
+                    break;
+            }
+        }
+    }
+
+    extern const Table CALC_KERNELS_TABLE = {
+        CALC_KERNELS_ISA,
+        batchTable<float>(), batchTable<double>(), batchTable<long double>(),
+        batchTable<int32_t>(), batchTable<int64_t>(),
+        divideMasked, squareRootMasked,
+        sumChunk, dotChunk, productChunk, extremumChunk<true>, extremumChunk<false>,
+        polyvalBatch, polyvalOne, chebvalBatch,
+        gemm, gemv,
+        sqrt, rsqrt, exp, log, sin, cos, pow
+    };
+}
+}
@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <vector>
+#include "calc/matrix.h"
+#include "calc/trace.h"
+#include "kernel_table.h"
+#include "pool.h"
+
+namespace calc {
+    namespace {
+        // Products smaller than this many multiply-adds stay on the calling thread
+        const size_t PARALLEL_WORK = (size_t)1 << 22;
+        const size_t GEMV_ROWS = 256;
+        const size_t TRANSPOSE_BLOCK = 32;
+
+        unsigned threadsFor(const MatrixOptions& options, size_t work, size_t tasks) {
+            if (work < PARALLEL_WORK) {
+                return 1;
+            }
+            unsigned threads = options.threads ? options.threads : pool::hardwareThreads();
+            return (unsigned)std::min<size_t>(threads, tasks);
+        }
+
+        // Packing space for gemm, kept per thread across calls
+        double* workspace() {
+            thread_local std::vector<double> buffer(dispatch::GEMM_WORKSPACE);
+            return buffer.data();
+        }
+
+        bool sameShape(const Matrix& a, const Matrix& b) {
+            return a.rows() == b.rows() && a.cols() == b.cols();
+        }
+
+        // Gives out the shape of a, touching its values only when the shape changes
+        void reshapeLike(Matrix& out, const Matrix& a) {
+            if (!sameShape(out, a)) {
+                out.assign(a.rows(), a.cols());
+            }
+        }
+
+        void reshapeLike(Vector& out, const Vector& a) {
+            if (out.size() != a.size()) {
+                out.assign(a.size());
+            }
+        }
+
+        template<typename T, typename Op>
+        bool elementwise(const T& a, const T& b, T& out, bool sameShape, Op op) {
+            if (!sameShape) {
+                return false;
+            }
+            reshapeLike(out, a);
+            op(a.data(), b.data(), out.data(), a.size());
+            return true;
+        }
+    }
+
+    Matrix::Matrix(std::initializer_list<std::initializer_list<double>> rows) : rows_(rows.size()) {
+        for (const std::initializer_list<double>& r : rows) {
+            cols_ = std::max(cols_, r.size());
+        }
+        values_.assign(rows_ * cols_, 0.0);
+        size_t i = 0;
+        for (const std::initializer_list<double>& r : rows) {
+            std::copy(r.begin(), r.end(), values_.begin() + i * cols_);
+            i++;
+        }
+    }
+
+    Matrix Matrix::identity(size_t n) {
+        Matrix m(n, n);
+        for (size_t i = 0; i < n; i++) {
+            m(i, i) = 1.0;
+        }
+        return m;
+    }
+
+    void Matrix::assign(size_t rows, size_t cols, double value) {
+        rows_ = rows;
+        cols_ = cols;
+        values_.assign(rows * cols, value);
+    }
+
+    // Threads take bands of rows; each band repacks b, which costs 1/GEMM_MC of its work.
+    bool multiply(const Matrix& a, const Matrix& b, Matrix& out, const MatrixOptions& options) {
+        if (a.cols() != b.rows()) {
+            return false;
+        }
+        size_t m = a.rows();
+        size_t n = b.cols();
+        size_t k = a.cols();
+        CALC_TRACE_BATCH(MatrixMultiply, m * n * k);
+
+        Matrix temporary;
+        Matrix& result = (&out == &a || &out == &b) ? temporary : out;
+        result.assign(m, n);
+        const dispatch::Table& t = dispatch::table();
+        size_t blocks = (m + dispatch::GEMM_MC - 1) / dispatch::GEMM_MC;
+        unsigned threads = threadsFor(options, m * n * k, blocks);
+        if (threads <= 1) {
+            t.gemm(m, n, k, a.data(), k, b.data(), n, result.data(), n, workspace());
+        } else {
+            // A few bands per thread evens out the finishing times
+            size_t bands = std::min<size_t>(blocks, (size_t)threads * 4);
+            size_t band = (blocks + bands - 1) / bands * dispatch::GEMM_MC;
+            pool::parallelFor((m + band - 1) / band, threads, [&](size_t i) {
+                size_t start = i * band;
+                size_t rows = std::min(band, m - start);
+                t.gemm(rows, n, k, a.row(start), k, b.data(), n, result.row(start), n, workspace());
+            });
+        }
+        if (&result == &temporary) {
+            out = std::move(temporary);
+        }
+        return true;
+    }
+
+    bool multiply(const Matrix& a, const Vector& x, Vector& out, const MatrixOptions& options) {
+        if (a.cols() != x.size()) {
+            return false;
+        }
+        size_t m = a.rows();
+        size_t n = a.cols();
+        CALC_TRACE_BATCH(MatrixMultiply, m * n);
+
+        Vector temporary;
+        Vector& result = &out == &x ? temporary : out;
+        result.assign(m);
+        const dispatch::Table& t = dispatch::table();
+        size_t bands = (m + GEMV_ROWS - 1) / GEMV_ROWS;
+        unsigned threads = threadsFor(options, m * n, bands);
+        if (threads <= 1) {
+            t.gemv(m, n, a.data(), n, x.data(), result.data());
+        } else {
+            pool::parallelFor(bands, threads, [&](size_t i) {
+                size_t start = i * GEMV_ROWS;
+                t.gemv(std::min(GEMV_ROWS, m - start), n, a.row(start), n, x.data(), result.data() + start);
+            });
+        }
+        if (&result == &temporary) {
+            out = std::move(temporary);
+        }
+        return true;
+    }
+
+    // Square blocks keep both the rows read and the columns written within cache.
+    Matrix transpose(const Matrix& a) {
+        size_t rows = a.rows();
+        size_t cols = a.cols();
+        Matrix t(cols, rows);
+        const double* in = a.data();
+        double* out = t.data();
+        for (size_t r0 = 0; r0 < rows; r0 += TRANSPOSE_BLOCK) {
+            size_t r1 = std::min(rows, r0 + TRANSPOSE_BLOCK);
+            for (size_t c0 = 0; c0 < cols; c0 += TRANSPOSE_BLOCK) {
+                size_t c1 = std::min(cols, c0 + TRANSPOSE_BLOCK);
+                for (size_t r = r0; r < r1; r++) {
+                    for (size_t c = c0; c < c1; c++) {
+                        out[c * rows + r] = in[r * cols + c];
+                    }
+                }
+            }
+        }
+        return t;
+    }
+
+    bool add(const Matrix& a, const Matrix& b, Matrix& out) {
+        return elementwise(a, b, out, sameShape(a, b), [](const double* x, const double* y, double* z, size_t n) { add(x, y, z, n); });
+    }
+
+    bool subtract(const Matrix& a, const Matrix& b, Matrix& out) {
+        return elementwise(a, b, out, sameShape(a, b), [](const double* x, const double* y, double* z, size_t n) { subtract(x, y, z, n); });
+    }
+
+    bool multiplyElements(const Matrix& a, const Matrix& b, Matrix& out) {
+        return elementwise(a, b, out, sameShape(a, b), [](const double* x, const double* y, double* z, size_t n) { multiply(x, y, z, n); });
+    }
+
+    bool divideElements(const Matrix& a, const Matrix& b, Matrix& out) {
+        return elementwise(a, b, out, sameShape(a, b), [](const double* x, const double* y, double* z, size_t n) { divide(x, y, z, n); });
+    }
+
+    bool add(const Vector& a, const Vector& b, Vector& out) {
+        return elementwise(a, b, out, a.size() == b.size(), [](const double* x, const double* y, double* z, size_t n) { add(x, y, z, n); });
+    }
+
+    bool subtract(const Vector& a, const Vector& b, Vector& out) {
+        return elementwise(a, b, out, a.size() == b.size(), [](const double* x, const double* y, double* z, size_t n) { subtract(x, y, z, n); });
+    }
+
+    bool multiplyElements(const Vector& a, const Vector& b, Vector& out) {
+        return elementwise(a, b, out, a.size() == b.size(), [](const double* x, const double* y, double* z, size_t n) { multiply(x, y, z, n); });
+    }
+
+    bool divideElements(const Vector& a, const Vector& b, Vector& out) {
+        return elementwise(a, b, out, a.size() == b.size(), [](const double* x, const double* y, double* z, size_t n) { divide(x, y, z, n); });
+    }
+}
@@ -0,0 +1,23 @@
+#include "calc/poly.h"
+#include "kernel_table.h"
+
+// The loops live in kernels_impl.h, built once per instruction set.
+namespace calc {
+    void polyval(const double* coeffs, size_t degree, const double* x, double* out, size_t n) {
+        dispatch::table().polyval(coeffs, degree, x, out, n);
+    }
+
+    double polyval(const double* coeffs, size_t degree, double x) {
+        return dispatch::table().polyvalOne(coeffs, degree, x);
+    }
+
+    void chebval(const double* coeffs, size_t degree, const double* x, double* out, size_t n, double lo, double hi) {
+        dispatch::table().chebval(coeffs, degree, lo, hi, x, out, n);
+    }
+
+    double chebval(const double* coeffs, size_t degree, double x, double lo, double hi) {
+        double result;
+        dispatch::table().chebval(coeffs, degree, lo, hi, &x, &result, 1);
+        return result;
+    }
+}
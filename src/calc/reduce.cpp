@@ -0,0 +1,153 @@
+#include <math.h>
+#include <mutex>
+#include <vector>
+#include "calc/reduce.h"
+#include "calc/trace.h"
+#include "kernel_table.h"
+#include "pool.h"
+
+namespace calc {
+    namespace {
+        using dispatch::Compensated;
+
+        // Deterministic mode chunk: fixed, so the partials never depend on the thread count
+        const size_t CHUNK = 32768;
+        const size_t NOT_FOUND = (size_t)-1;
+
+        // Splits [0, n) into pieces reduced by chunk(start, count) and merged by combine.
+        template<typename Partial, typename Chunk, typename Combine>
+        Partial reduce(size_t n, const ReduceOptions& options, Partial identity, Chunk chunk, Combine combine) {
+            unsigned threads = options.threads ? options.threads : pool::hardwareThreads();
+            if (options.deterministic) {
+                size_t chunks = (n + CHUNK - 1) / CHUNK;
+                std::vector<Partial> partials(chunks);
+                pool::parallelFor(chunks, threads, [&](size_t c) {
+                    size_t start = c * CHUNK;
+                    partials[c] = chunk(start, std::min(CHUNK, n - start));
+                });
+                Partial result = identity;
+                for (const Partial& partial : partials) {
+                    result = combine(result, partial);
+                }
+                return result;
+            }
+
+            size_t shares = std::min<size_t>(threads, (n + CHUNK - 1) / CHUNK);
+            if (shares <= 1) {
+                return n ? combine(identity, chunk(0, n)) : identity;
+            }
+            size_t share = (n + shares - 1) / shares;
+            Partial result = identity;
+            std::mutex mutex;
+            pool::parallelFor(shares, (unsigned)shares, [&](size_t s) {
+                size_t start = s * share;
+                if (start >= n) {
+                    return;
+                }
+                Partial partial = chunk(start, std::min(share, n - start));
+                std::lock_guard<std::mutex> lock(mutex);
+                result = combine(result, partial);
+            });
+            return result;
+        }
+
+        // Drops an error term that went non-finite, as the chunk kernels do, so an
+        // infinity or overflow gives +-inf rather than NaN
+        Compensated settle(Compensated r) {
+            if (!isfinite(r.value) || !isfinite(r.error)) {
+                r.error = 0.0;
+            }
+            return r;
+        }
+
+        double total(Compensated r) {
+            r = settle(r);
+            return r.value + r.error;
+        }
+
+        Compensated addPartials(Compensated x, Compensated y) {
+            double s = x.value + y.value;
+            double bb = s - x.value;
+            double e = (x.value - (s - bb)) + (y.value - bb);
+            return settle(Compensated{s, e + x.error + y.error});
+        }
+
+        Compensated multiplyPartials(Compensated x, Compensated y) {
+            double p = x.value * y.value;
+            // fma is exact even where libm emulates it, and this runs once per chunk
+            double e = fma(x.value, y.value, -p);
+            return settle(Compensated{p, e + (x.value * y.error + x.error * y.value)});
+        }
+
+        // Extremum indices are relative to the chunk until rebased here
+        template<bool Less>
+        Extremum better(Extremum x, Extremum y) {
+            if (y.index == NOT_FOUND) {
+                return x;
+            }
+            if (x.index == NOT_FOUND) {
+                return y;
+            }
+            bool takeY = Less ? y.value < x.value : y.value > x.value;
+            if (takeY || (y.value == x.value && y.index < x.index)) {
+                return y;
+            }
+            return x;
+        }
+
+        template<bool Less>
+        Extremum extremum(const double* x, size_t n, const ReduceOptions& options) {
+            const dispatch::Table& t = dispatch::table();
+            Extremum result = reduce(n, options, Extremum{NAN, NOT_FOUND},
+                [&](size_t start, size_t count) {
+                    Extremum e = Less ? t.minimum(x + start, count) : t.maximum(x + start, count);
+                    if (e.index != NOT_FOUND) {
+                        e.index += start;
+                    }
+                    return e;
+                },
+                better<Less>);
+            if (result.index == NOT_FOUND) {
+                result.index = n;
+            }
+            return result;
+        }
+    }
+
+    double sum(const double* x, size_t n, const ReduceOptions& options) {
+        CALC_TRACE_BATCH(Sum, n);
+        const dispatch::Table& t = dispatch::table();
+        Compensated result = reduce(n, options, Compensated{0.0, 0.0},
+            [&](size_t start, size_t count) { return t.sum(x + start, count); },
+            addPartials);
+        return total(result);
+    }
+
+    double dot(const double* a, const double* b, size_t n, const ReduceOptions& options) {
+        CALC_TRACE_BATCH(Dot, n);
+        const dispatch::Table& t = dispatch::table();
+        Compensated result = reduce(n, options, Compensated{0.0, 0.0},
+            [&](size_t start, size_t count) { return t.dot(a + start, b + start, count); },
+            addPartials);
+        return total(result);
+    }
+
+    double product(const double* x, size_t n, const ReduceOptions& options) {
+        CALC_TRACE_BATCH(Product, n);
+        const dispatch::Table& t = dispatch::table();
+        Compensated result = reduce(n, options, Compensated{1.0, 0.0},
+            [&](size_t start, size_t count) { return t.product(x + start, count); },
+            multiplyPartials);
+        return total(result);
+    }
+
+    Extremum minimum(const double* x, size_t n, const ReduceOptions& options) {
+        CALC_TRACE_BATCH(Minimum, n);
+        return extremum<true>(x, n, options);
+    }
+
+    Extremum maximum(const double* x, size_t n, const ReduceOptions& options) {
+        CALC_TRACE_BATCH(Maximum, n);
+        return extremum<false>(x, n, options);
+    }
+}
@@ -0,0 +1,256 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_set>
+#include "calc/sheet.h"
+#include "pool.h"
+
+namespace calc {
+    namespace {
+        // Levels with fewer formulas to evaluate than this stay on the calling thread
+        const size_t PARALLEL_CELLS = 4096;
+        const size_t CELLS_PER_TASK = 1024;
+
+        bool sameBits(double a, double b) {
+            return memcmp(&a, &b, sizeof(double)) == 0;
+        }
+    }
+
+    int Sheet::cell(const std::string& name) {
+        int found = find(name);
+        if (found >= 0) {
+            return found;
+        }
+        int id = (int)names_.size();
+        index_.emplace(name, id);
+        names_.push_back(name);
+        values_.push_back(NAN);
+        formulas_.emplace_back();
+        dependents_.emplace_back();
+        levels_.push_back(0);
+        queued_.push_back(0);
+        changed_.push_back(0);
+        return id;
+    }
+
+    int Sheet::find(const std::string& name) const {
+        std::unordered_map<std::string, int>::const_iterator it = index_.find(name);
+        return it == index_.end() ? -1 : it->second;
+    }
+
+    double Sheet::value(const std::string& name) const {
+        int id = find(name);
+        return id < 0 ? NAN : values_[id];
+    }
+
+    bool Sheet::define(const std::string& name, const std::string& formula, std::string* error) {
+        Expression expression;
+        if (!expression.compile(formula, error)) {
+            return false;
+        }
+        // Only cells that exist already can close a cycle
+        int target = find(name);
+        if (target >= 0) {
+            std::vector<int> existing;
+            for (const std::string& variable : expression.variables()) {
+                int id = find(variable);
+                if (id >= 0) {
+                    existing.push_back(id);
+                }
+            }
+            if (reaches(target, existing)) {
+                if (error) {
+                    *error = "cell '" + name + "' would depend on itself";
+                }
+                return false;
+            }
+        } else if (std::find(expression.variables().begin(), expression.variables().end(), name) != expression.variables().end()) {
+            if (error) {
+                *error = "cell '" + name + "' would depend on itself";
+            }
+            return false;
+        }
+
+        target = cell(name);
+        std::vector<int> inputs;
+        uint32_t level = 0;
+        for (const std::string& variable : expression.variables()) {
+            int id = cell(variable);
+            inputs.push_back(id);
+            level = std::max(level, levels_[id] + 1);
+        }
+        detach(target);
+        for (int id : inputs) {
+            dependents_[id].push_back(target);
+        }
+        formulas_[target].expression = std::move(expression);
+        formulas_[target].inputs = std::move(inputs);
+        raiseLevel(target, level);
+        enqueue(target);
+        return true;
+    }
+
+    void Sheet::set(int cell, double value) {
+        if (isFormula(cell)) {
+            detach(cell);
+            formulas_[cell] = Formula();
+        }
+        if (sameBits(values_[cell], value)) {
+            return;
+        }
+        values_[cell] = value;
+        if (!changed_[cell]) {
+            changed_[cell] = 1;
+            changes_.push_back(cell);
+        }
+    }
+
+    size_t Sheet::recompute(const SheetOptions& options) {
+        for (int changed : changes_) {
+            changed_[changed] = 0;
+            wakeDependents(changed);
+        }
+        changes_.clear();
+
+        unsigned threads = options.threads ? options.threads : pool::hardwareThreads();
+        size_t evaluated = 0;
+        std::vector<int> cells;
+        std::vector<uint8_t> differs;
+        for (size_t level = 0; level < buckets_.size(); level++) {
+            if (buckets_[level].empty()) {
+                continue;
+            }
+            cells.clear();
+            cells.swap(buckets_[level]);
+            // Drop cells turned into inputs, and move those whose level rose since
+            size_t kept = 0;
+            for (int id : cells) {
+                if (!isFormula(id)) {
+                    queued_[id] = 0;
+                } else if (levels_[id] != level) {
+                    if (buckets_.size() <= levels_[id]) {
+                        buckets_.resize(levels_[id] + 1);
+                    }
+                    buckets_[levels_[id]].push_back(id);
+                } else {
+                    cells[kept++] = id;
+                }
+            }
+            cells.resize(kept);
+            differs.assign(kept, 0);
+
+            // Cells of one level only read lower levels, so they can run in any order
+            auto evaluate = [&](size_t begin, size_t end) {
+                std::vector<double> arguments;
+                for (size_t i = begin; i < end; i++) {
+                    const Formula& formula = formulas_[cells[i]];
+                    arguments.resize(formula.inputs.size());
+                    for (size_t v = 0; v < formula.inputs.size(); v++) {
+                        arguments[v] = values_[formula.inputs[v]];
+                    }
+                    double result = formula.expression.evaluate(arguments.data());
+                    differs[i] = !sameBits(values_[cells[i]], result);
+                    values_[cells[i]] = result;
+                }
+            };
+            if (kept >= PARALLEL_CELLS && threads > 1) {
+                size_t tasks = (kept + CELLS_PER_TASK - 1) / CELLS_PER_TASK;
+                pool::parallelFor(tasks, threads, [&](size_t t) {
+                    evaluate(t * CELLS_PER_TASK, std::min(kept, (t + 1) * CELLS_PER_TASK));
+                });
+            } else {
+                evaluate(0, kept);
+            }
+
+            for (size_t i = 0; i < kept; i++) {
+                queued_[cells[i]] = 0;
+                if (differs[i]) {
+                    wakeDependents(cells[i]);
+                }
+            }
+            evaluated += kept;
+        }
+        return evaluated;
+    }
+
+    // Removes cell from the dependents of the cells its formula read.
+    void Sheet::detach(int cell) {
+        for (int input : formulas_[cell].inputs) {
+            std::vector<int>& readers = dependents_[input];
+            readers.erase(std::find(readers.begin(), readers.end(), cell));
+        }
+    }
+
+    // Lifts cell to at least level and its dependents above it. Levels never come down
+    // again; only their order matters.
+    void Sheet::raiseLevel(int cell, uint32_t level) {
+        if (levels_[cell] >= level) {
+            return;
+        }
+        levels_[cell] = level;
+        std::vector<int> stack(1, cell);
+        while (!stack.empty()) {
+            int id = stack.back();
+            stack.pop_back();
+            for (int reader : dependents_[id]) {
+                if (levels_[reader] <= levels_[id]) {
+                    levels_[reader] = levels_[id] + 1;
+                    stack.push_back(reader);
+                }
+            }
+        }
+    }
+
+    // True when one of targets is cell itself or reads it, directly or not.
+    bool Sheet::reaches(int from, const std::vector<int>& targets) const {
+        // A reader sits above what it reads, so only targets above from can qualify,
+        // and the search never needs to climb past the highest of them
+        uint32_t ceiling = 0;
+        bool any = false;
+        for (int target : targets) {
+            if (target == from) {
+                return true;
+            }
+            if (levels_[target] > levels_[from]) {
+                ceiling = std::max(ceiling, levels_[target]);
+                any = true;
+            }
+        }
+        if (!any) {
+            return false;
+        }
+        std::unordered_set<int> seen;
+        std::vector<int> stack(1, from);
+        while (!stack.empty()) {
+            int id = stack.back();
+            stack.pop_back();
+            for (int reader : dependents_[id]) {
+                if (levels_[reader] > ceiling || !seen.insert(reader).second) {
+                    continue;
+                }
+                if (std::find(targets.begin(), targets.end(), reader) != targets.end()) {
+                    return true;
+                }
+                stack.push_back(reader);
+            }
+        }
+        return false;
+    }
+
+    void Sheet::enqueue(int cell) {
+        if (queued_[cell]) {
+            return;
+        }
+        queued_[cell] = 1;
+        if (buckets_.size() <= levels_[cell]) {
+            buckets_.resize(levels_[cell] + 1);
+        }
+        buckets_[levels_[cell]].push_back(cell);
+    }
+
+    void Sheet::wakeDependents(int cell) {
+        for (int reader : dependents_[cell]) {
+            enqueue(reader);
+        }
+    }
+}
@@ -0,0 +1,368 @@
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "calc/solve.h"
+#include "pool.h"
+
+namespace calc {
+    namespace {
+        // Kronrod 21-point nodes (positive half, the last is the centre) and weights, and
+        // the weights of the 10-point Gauss rule on the odd-indexed nodes (QUADPACK qk21)
+        const double KRONROD_NODES[11] = {
+            0.995657163025808080735527280689003, 0.973906528517171720077964012084452,
+            0.930157491355708226001207180059508, 0.865063366688984510732096688423493,
+            0.780817726586416897063717578345042, 0.679409568299024406234327365114874,
+            0.562757134668604683339000099272694, 0.433395394129247190799265943165784,
+            0.294392862701460198131126603103866, 0.148874338981631210884826001129720,
+            0.0
+        };
+        const double KRONROD_WEIGHTS[11] = {
+            0.011694638867371874278064396062192, 0.032558162307964727478818972459390,
+            0.054755896574351996031381300244580, 0.075039674810919952767043140916190,
+            0.093125454583697605535065465083366, 0.109387158802297641899210590325805,
+            0.123491976262065851077208980164785, 0.134709217311473325928054001771707,
+            0.142775938577060080797094273138717, 0.147739104901338491374841515972068,
+            0.149445554002916905664936468389821
+        };
+        const double GAUSS_WEIGHTS[5] = {
+            0.066671344308688137593568809893332, 0.149451349150580593145776339657697,
+            0.219086362515982043995534934228163, 0.269266719309996355091226921569469,
+            0.295524224714752870173892994651338
+        };
+        const size_t RULE_POINTS = 21;
+        // Subintervals bisected per round; fixed so results do not depend on threads
+        const size_t ROUND_INTERVALS = 32;
+        // Intervals with less than this fraction of the worst one's error wait a round
+        const double SPLIT_RATIO = 1.0 / 64;
+        // Subintervals per parallel task
+        const size_t TASK_INTERVALS = 8;
+
+        struct Interval {
+            double a;
+            double b;
+            double value;
+            double error;
+        };
+
+        bool smallerError(const Interval& x, const Interval& y) {
+            return x.error < y.error;
+        }
+
+        // Nodes of [a, b]: centre, then the pairs centre -+ half * node.
+        void placeNodes(double a, double b, double* x) {
+            double centre = 0.5 * (a + b);
+            double half = 0.5 * (b - a);
+            x[0] = centre;
+            for (int j = 0; j < 10; j++) {
+                x[1 + 2 * j] = centre - half * KRONROD_NODES[j];
+                x[2 + 2 * j] = centre + half * KRONROD_NODES[j];
+            }
+        }
+
+        // Applies both rules to the values at placeNodes() points (QUADPACK qk21).
+        void applyRule(Interval& interval, const double* f) {
+            double kronrod = KRONROD_WEIGHTS[10] * f[0];
+            double gauss = 0.0;
+            double absolute = KRONROD_WEIGHTS[10] * fabs(f[0]);
+            for (int j = 0; j < 10; j++) {
+                double pair = f[1 + 2 * j] + f[2 + 2 * j];
+                kronrod += KRONROD_WEIGHTS[j] * pair;
+                absolute += KRONROD_WEIGHTS[j] * (fabs(f[1 + 2 * j]) + fabs(f[2 + 2 * j]));
+                if (j % 2 == 1) {
+                    gauss += GAUSS_WEIGHTS[j / 2] * pair;
+                }
+            }
+            // Spread of f around its mean, which scales the raw Kronrod - Gauss difference
+            double mean = 0.5 * kronrod;
+            double spread = KRONROD_WEIGHTS[10] * fabs(f[0] - mean);
+            for (int j = 0; j < 10; j++) {
+                spread += KRONROD_WEIGHTS[j] * (fabs(f[1 + 2 * j] - mean) + fabs(f[2 + 2 * j] - mean));
+            }
+            double half = 0.5 * (interval.b - interval.a);
+            double width = fabs(half);
+            double error = fabs((kronrod - gauss) * half);
+            spread *= width;
+            absolute *= width;
+            if (spread != 0.0 && error != 0.0) {
+                error = spread * std::min(1.0, pow(200.0 * error / spread, 1.5));
+            }
+            if (absolute > DBL_MIN / (50.0 * DBL_EPSILON)) {
+                error = std::max(50.0 * DBL_EPSILON * absolute, error);
+            }
+            interval.value = kronrod * half;
+            interval.error = error;
+        }
+
+        // Evaluates the rules on every interval: one batch of nodes per task.
+        void evaluateIntervals(const BatchFunction& f, Interval* intervals, size_t count, unsigned threads) {
+            size_t tasks = (count + TASK_INTERVALS - 1) / TASK_INTERVALS;
+            pool::parallelFor(tasks, threads, [&](size_t t) {
+                size_t begin = t * TASK_INTERVALS;
+                size_t end = std::min(count, begin + TASK_INTERVALS);
+                double x[TASK_INTERVALS * RULE_POINTS];
+                double y[TASK_INTERVALS * RULE_POINTS];
+                for (size_t i = begin; i < end; i++) {
+                    placeNodes(intervals[i].a, intervals[i].b, x + (i - begin) * RULE_POINTS);
+                }
+                f(x, y, (end - begin) * RULE_POINTS);
+                for (size_t i = begin; i < end; i++) {
+                    applyRule(intervals[i], y + (i - begin) * RULE_POINTS);
+                }
+            });
+        }
+
+        BatchFunction expressionBatch(const Expression& expression) {
+            return [&expression](const double* x, double* out, size_t n) {
+                const double* columns[1] = {x};
+                expression.evaluate(columns, out, n);
+            };
+        }
+    }
+
+    IntegrateResult integrate(const BatchFunction& f, double a, double b, const IntegrateOptions& options) {
+        IntegrateResult result = {0.0, 0.0, 0, 0, true};
+        if (a == b) {
+            return result;
+        }
+        if (!isfinite(a) || !isfinite(b)) {
+            result.value = NAN;
+            result.error = INFINITY;
+            result.converged = false;
+            return result;
+        }
+        unsigned threads = options.threads ? options.threads : pool::hardwareThreads();
+
+        // A max-heap on error; each round bisects the worst intervals
+        std::vector<Interval> heap(1, Interval{a, b, 0.0, 0.0});
+        evaluateIntervals(f, heap.data(), 1, 1);
+        result.evaluations = RULE_POINTS;
+        // Totals are kept up to date as intervals come and go, and summed afresh before
+        // the answer is trusted, so rounding in the running sums cannot end the search
+        double value = heap[0].value;
+        double error = heap[0].error;
+        bool exact = true;
+        std::vector<Interval> children;
+        std::vector<Interval> unsplittable;
+        for (;;) {
+            double tolerance = std::max(options.absoluteTolerance, options.relativeTolerance * fabs(value));
+            if ((error <= tolerance || !isfinite(error)) && !exact) {
+                value = 0.0;
+                error = 0.0;
+                for (const Interval& interval : heap) {
+                    value += interval.value;
+                    error += interval.error;
+                }
+                for (const Interval& interval : unsplittable) {
+                    value += interval.value;
+                    error += interval.error;
+                }
+                exact = true;
+                continue;
+            }
+            result.value = value;
+            result.error = error;
+            result.intervals = heap.size() + unsplittable.size();
+            if (error <= tolerance || !isfinite(error)) {
+                result.converged = isfinite(error);
+                return result;
+            }
+            if (heap.empty() || result.intervals + ROUND_INTERVALS > options.maxIntervals) {
+                result.converged = false;
+                return result;
+            }
+
+            // Split the worst intervals, but none whose error is already negligible next
+            // to the worst one, or that the remaining error could do without
+            children.clear();
+            double remaining = error;
+            double worstError = heap.front().error;
+            for (size_t i = 0; i < ROUND_INTERVALS && !heap.empty(); i++) {
+                if (i > 0 && (heap.front().error < worstError * SPLIT_RATIO || remaining <= tolerance)) {
+                    break;
+                }
+                std::pop_heap(heap.begin(), heap.end(), smallerError);
+                Interval worst = heap.back();
+                heap.pop_back();
+                double middle = 0.5 * (worst.a + worst.b);
+                if (middle == worst.a || middle == worst.b) {
+                    // Too narrow to split in double precision
+                    unsplittable.push_back(worst);
+                    continue;
+                }
+                remaining -= worst.error;
+                value -= worst.value;
+                error -= worst.error;
+                children.push_back(Interval{worst.a, middle, 0.0, 0.0});
+                children.push_back(Interval{middle, worst.b, 0.0, 0.0});
+            }
+            evaluateIntervals(f, children.data(), children.size(), threads);
+            result.evaluations += children.size() * RULE_POINTS;
+            for (const Interval& child : children) {
+                value += child.value;
+                error += child.error;
+                heap.push_back(child);
+                std::push_heap(heap.begin(), heap.end(), smallerError);
+            }
+            exact = false;
+        }
+    }
+
+    IntegrateResult integrate(const std::function<double(double)>& f, double a, double b, const IntegrateOptions& options) {
+        return integrate([&f](const double* x, double* out, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                out[i] = f(x[i]);
+            }
+        }, a, b, options);
+    }
+
+    bool integrate(const Expression& expression, double a, double b, IntegrateResult& result,
+                   const IntegrateOptions& options, std::string* error) {
+        if (!expression.valid() || expression.variables().size() > 1) {
+            if (error) {
+                *error = expression.valid() ? "the expression has more than one variable" : "the expression is not compiled";
+            }
+            return false;
+        }
+        result = integrate(expressionBatch(expression), a, b, options);
+        return true;
+    }
+
+    RootResult findRoot(const std::function<double(double)>& f, double a, double b, const RootOptions& options) {
+        RootResult result = {NAN, NAN, 0, false};
+        double fa = f(a);
+        double fb = f(b);
+        if (fa == 0.0 || fb == 0.0) {
+            result.root = fa == 0.0 ? a : b;
+            result.value = 0.0;
+            result.converged = true;
+            return result;
+        }
+        if (!(fa < 0.0 ? fb > 0.0 : fa > 0.0 && fb < 0.0)) {
+            return result;
+        }
+
+        // b is the best estimate, a the previous one, c keeps f(c) opposite to f(b)
+        double c = b;
+        double fc = fb;
+        double d = 0.0;
+        double e = 0.0;
+        for (size_t iteration = 1; iteration <= options.maxIterations; iteration++) {
+            if ((fb > 0.0) == (fc > 0.0)) {
+                c = a;
+                fc = fa;
+                d = e = b - a;
+            }
+            if (fabs(fc) < fabs(fb)) {
+                a = b;
+                b = c;
+                c = a;
+                fa = fb;
+                fb = fc;
+                fc = fa;
+            }
+            double tolerance = 2.0 * DBL_EPSILON * fabs(b) + 0.5 * options.tolerance;
+            double middle = 0.5 * (c - b);
+            result.root = b;
+            result.value = fb;
+            result.iterations = iteration;
+            if (fabs(middle) <= tolerance || fb == 0.0) {
+                result.converged = true;
+                return result;
+            }
+            if (fabs(e) >= tolerance && fabs(fa) > fabs(fb)) {
+                // Inverse quadratic interpolation, or the secant step when a == c
+                double s = fb / fa;
+                double p;
+                double q;
+                if (a == c) {
+                    p = 2.0 * middle * s;
+                    q = 1.0 - s;
+                } else {
+                    double r = fb / fc;
+                    q = fa / fc;
+                    p = s * (2.0 * middle * q * (q - r) - (b - a) * (r - 1.0));
+                    q = (q - 1.0) * (r - 1.0) * (s - 1.0);
+                }
+                if (p > 0.0) {
+                    q = -q;
+                }
+                p = fabs(p);
+                if (2.0 * p < std::min(3.0 * middle * q - fabs(tolerance * q), fabs(e * q))) {
+                    e = d;
+                    d = p / q;
+                } else {
+                    d = middle;
+                    e = d;
+                }
+            } else {
+                d = middle;
+                e = d;
+            }
+            a = b;
+            fa = fb;
+            b += fabs(d) > tolerance ? d : copysign(tolerance, middle);
+            fb = f(b);
+            if (isnan(fb)) {
+                result.root = b;
+                result.value = fb;
+                return result;
+            }
+        }
+        return result;
+    }
+
+    bool findRoot(const Expression& expression, double a, double b, RootResult& result,
+                  const RootOptions& options, std::string* error) {
+        if (!expression.valid() || expression.variables().size() != 1) {
+            if (error) {
+                *error = expression.valid() ? "the expression must have exactly one variable" : "the expression is not compiled";
+            }
+            return false;
+        }
+        result = findRoot([&expression](double x) { return expression.evaluate(&x); }, a, b, options);
+        return true;
+    }
+
+    std::vector<RootResult> findRoots(const BatchFunction& f, double a, double b, size_t samples, const RootOptions& options) {
+        std::vector<RootResult> roots;
+        if (samples == 0 || !isfinite(a) || !isfinite(b)) {
+            return roots;
+        }
+        std::vector<double> x(samples + 1);
+        std::vector<double> y(samples + 1);
+        for (size_t i = 0; i <= samples; i++) {
+            x[i] = i == samples ? b : a + (b - a) * ((double)i / (double)samples);
+        }
+        f(x.data(), y.data(), x.size());
+
+        // A zero sample is a root by itself; otherwise look for a sign change
+        std::vector<size_t> brackets;
+        for (size_t i = 0; i < samples; i++) {
+            bool zero = y[i] == 0.0;
+            bool crossing = (y[i] < 0.0 && y[i + 1] > 0.0) || (y[i] > 0.0 && y[i + 1] < 0.0);
+            if (zero || crossing) {
+                brackets.push_back(i);
+            }
+        }
+        if (y[samples] == 0.0) {
+            brackets.push_back(samples);
+        }
+
+        roots.resize(brackets.size());
+        unsigned threads = options.threads ? options.threads : pool::hardwareThreads();
+        pool::parallelFor(brackets.size(), threads, [&](size_t k) {
+            size_t i = brackets[k];
+            if (y[i] == 0.0) {
+                roots[k] = RootResult{x[i], 0.0, 0, true};
+                return;
+            }
+            roots[k] = findRoot([&f](double point) {
+                double value;
+                f(&point, &value, 1);
+                return value;
+            }, x[i], x[i + 1], options);
+        });
+        return roots;
+    }
+}
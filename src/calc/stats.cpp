@@ -0,0 +1,312 @@
+#include <math.h>
+#include <algorithm>
+#include "calc/kernels.h"
+#include "calc/stats.h"
+
+namespace calc {
+    namespace {
+        const size_t BLOCK = 256;
+        const double MIN_MAGNITUDE = 1e-300;
+    }
+
+    //=============================================================================
+    // Moments
+    //=============================================================================
+
+    Moments::Moments()
+        : count_(0), nanCount_(0), mean_(0.0), m2_(0.0), m3_(0.0), m4_(0.0), min_(NAN), max_(NAN) {
+    }
+
+    void Moments::add(double x) {
+        if (x != x) {
+            nanCount_++;
+            return;
+        }
+        double n1 = (double)count_;
+        count_++;
+        double n = (double)count_;
+        double delta = x - mean_;
+        double deltaN = delta / n;
+        double deltaN2 = deltaN * deltaN;
+        double term = delta * deltaN * n1;
+        mean_ += deltaN;
+        m4_ += term * deltaN2 * (n * n - 3 * n + 3) + 6 * deltaN2 * m2_ - 4 * deltaN * m3_;
+        m3_ += term * deltaN * (n - 2) - 3 * deltaN * m2_;
+        m2_ += term;
+        min_ = (count_ == 1 || x < min_) ? x : min_;
+        max_ = (count_ == 1 || x > max_) ? x : max_;
+    }
+
+    // Each block is summarized with two vectorizable passes (mean, then central sums)
+    // and merged, which is both faster and more accurate than per-sample updates.
+    void Moments::add(const double* x, size_t n) {
+        for (size_t start = 0; start < n; start += BLOCK) {
+            size_t count = std::min(BLOCK, n - start);
+            const double* in = x + start;
+
+            double valid = 0.0;
+            double total = 0.0;
+            double lo = INFINITY;
+            double hi = -INFINITY;
+            for (size_t i = 0; i < count; i++) {
+                bool ok = in[i] == in[i];
+                double v = ok ? in[i] : 0.0;
+                valid += ok ? 1.0 : 0.0;
+                total += v;
+                lo = ok && v < lo ? v : lo;
+                hi = ok && v > hi ? v : hi;
+            }
+            nanCount_ += count - (uint64_t)valid;
+            if (valid == 0.0) {
+                continue;
+            }
+
+            Moments block;
+            block.count_ = (uint64_t)valid;
+            block.mean_ = total / valid;
+            double m2 = 0.0;
+            double m3 = 0.0;
+            double m4 = 0.0;
+            for (size_t i = 0; i < count; i++) {
+                bool ok = in[i] == in[i];
+                double d = ok ? in[i] - block.mean_ : 0.0;
+                double d2 = d * d;
+                m2 += d2;
+                m3 += d2 * d;
+                m4 += d2 * d2;
+            }
+            block.m2_ = m2;
+            block.m3_ = m3;
+            block.m4_ = m4;
+            block.min_ = lo;
+            block.max_ = hi;
+            merge(block);
+        }
+    }
+
+    void Moments::merge(const Moments& other) {
+        nanCount_ += other.nanCount_;
+        if (other.count_ == 0) {
+            return;
+        }
+        if (count_ == 0) {
+            uint64_t nans = nanCount_;
+            *this = other;
+            nanCount_ = nans;
+            return;
+        }
+        double na = (double)count_;
+        double nb = (double)other.count_;
+        double n = na + nb;
+        double delta = other.mean_ - mean_;
+        double delta2 = delta * delta;
+        double m2 = m2_ + other.m2_ + delta2 * na * nb / n;
+        double m3 = m3_ + other.m3_ + delta2 * delta * na * nb * (na - nb) / (n * n) +
+                    3 * delta * (na * other.m2_ - nb * m2_) / n;
+        double m4 = m4_ + other.m4_ + delta2 * delta2 * na * nb * (na * na - na * nb + nb * nb) / (n * n * n) +
+                    6 * delta2 * (na * na * other.m2_ + nb * nb * m2_) / (n * n) +
+                    4 * delta * (na * other.m3_ - nb * m3_) / n;
+        mean_ += delta * nb / n;
+        m2_ = m2;
+        m3_ = m3;
+        m4_ = m4;
+        count_ += other.count_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    double Moments::mean() const {
+        return count_ ? mean_ : NAN;
+    }
+
+    double Moments::variance() const {
+        return count_ ? m2_ / (double)count_ : NAN;
+    }
+
+    double Moments::sampleVariance() const {
+        return count_ > 1 ? m2_ / (double)(count_ - 1) : NAN;
+    }
+
+    double Moments::standardDeviation() const {
+        return sqrt(variance());
+    }
+
+    double Moments::skewness() const {
+        if (count_ == 0 || m2_ == 0) {
+            return NAN;
+        }
+        return sqrt((double)count_) * m3_ / pow(m2_, 1.5);
+    }
+
+    double Moments::kurtosis() const {
+        if (count_ == 0 || m2_ == 0) {
+            return NAN;
+        }
+        return (double)count_ * m4_ / (m2_ * m2_) - 3.0;
+    }
+
+    //=============================================================================
+    // QuantileSketch
+    //=============================================================================
+
+    QuantileSketch::QuantileSketch(double relativeAccuracy, size_t maxBuckets)
+        : accuracy_(std::min(std::max(relativeAccuracy, 1e-6), 0.5)),
+          maxBuckets_(std::max<size_t>(maxBuckets, 1)),
+          zeros_(0), count_(0), min_(NAN), max_(NAN) {
+        gamma_ = (1 + accuracy_) / (1 - accuracy_);
+        multiplier_ = 1 / log(gamma_);
+    }
+
+    // Bucket k holds magnitudes in (gamma^(k-1), gamma^k]
+    int32_t QuantileSketch::key(double magnitude) const {
+        return (int32_t)ceil(log(magnitude) * multiplier_);
+    }
+
+    // The point of bucket k within relative error a of both of its edges
+    double QuantileSketch::value(int32_t key) const {
+        return 2 * exp(key / multiplier_) / (gamma_ + 1);
+    }
+
+    void QuantileSketch::Store::add(int32_t key, uint64_t n, size_t maxBuckets) {
+        if (counts.empty()) {
+            offset = key;
+            counts.assign(1, 0);
+        }
+        int64_t top = (int64_t)offset + (int64_t)counts.size() - 1;
+        if (key < offset) {
+            // Too far below the range: fold into the lowest bucket that still fits
+            int64_t lowest = std::max<int64_t>(key, top - (int64_t)maxBuckets + 1);
+            counts.insert(counts.begin(), (size_t)(offset - lowest), 0);
+            offset = (int32_t)lowest;
+            key = std::max(key, offset);
+        } else if (key > top) {
+            int64_t lowest = std::max<int64_t>(offset, (int64_t)key - (int64_t)maxBuckets + 1);
+            if (lowest > offset) {
+                // Collapse the buckets nearest zero into the new lowest one
+                size_t drop = (size_t)std::min<int64_t>(lowest - offset, (int64_t)counts.size());
+                uint64_t folded = 0;
+                for (size_t i = 0; i < drop; i++) {
+                    folded += counts[i];
+                }
+                counts.erase(counts.begin(), counts.begin() + drop);
+                offset = (int32_t)lowest;
+                if (counts.empty()) {
+                    counts.assign(1, 0);
+                }
+                counts[0] += folded;
+            }
+            counts.resize((size_t)(key - offset + 1), 0);
+        }
+        counts[(size_t)(key - offset)] += n;
+    }
+
+    void QuantileSketch::Store::merge(const Store& other, size_t maxBuckets) {
+        for (size_t i = 0; i < other.counts.size(); i++) {
+            if (other.counts[i]) {
+                add(other.offset + (int32_t)i, other.counts[i], maxBuckets);
+            }
+        }
+    }
+
+    void QuantileSketch::add(double x) {
+        if (!(fabs(x) < INFINITY)) {
+            return;
+        }
+        if (fabs(x) < MIN_MAGNITUDE) {
+            zeros_++;
+        } else if (x > 0) {
+            positive_.add(key(x), 1, maxBuckets_);
+        } else {
+            negative_.add(key(-x), 1, maxBuckets_);
+        }
+        min_ = (count_ == 0 || x < min_) ? x : min_;
+        max_ = (count_ == 0 || x > max_) ? x : max_;
+        count_++;
+    }
+
+    // Bucket keys for a block come from one vectorized log pass.
+    void QuantileSketch::add(const double* x, size_t n) {
+        double magnitude[BLOCK];
+        double logs[BLOCK];
+        for (size_t start = 0; start < n; start += BLOCK) {
+            size_t count = std::min(BLOCK, n - start);
+            const double* in = x + start;
+            for (size_t i = 0; i < count; i++) {
+                double m = fabs(in[i]);
+                magnitude[i] = m >= MIN_MAGNITUDE && m < INFINITY ? m : 1.0;
+            }
+            kernels::log(magnitude, logs, count);
+            for (size_t i = 0; i < count; i++) {
+                double v = in[i];
+                double m = fabs(v);
+                if (!(m < INFINITY)) {
+                    continue;
+                }
+                if (m < MIN_MAGNITUDE) {
+                    zeros_++;
+                } else {
+                    int32_t k = (int32_t)ceil(logs[i] * multiplier_);
+                    (v > 0 ? positive_ : negative_).add(k, 1, maxBuckets_);
+                }
+                min_ = (count_ == 0 || v < min_) ? v : min_;
+                max_ = (count_ == 0 || v > max_) ? v : max_;
+                count_++;
+            }
+        }
+    }
+
+    bool QuantileSketch::merge(const QuantileSketch& other) {
+        if (other.accuracy_ != accuracy_) {
+            return false;
+        }
+        if (other.count_ == 0) {
+            return true;
+        }
+        positive_.merge(other.positive_, maxBuckets_);
+        negative_.merge(other.negative_, maxBuckets_);
+        zeros_ += other.zeros_;
+        min_ = count_ ? std::min(min_, other.min_) : other.min_;
+        max_ = count_ ? std::max(max_, other.max_) : other.max_;
+        count_ += other.count_;
+        return true;
+    }
+
+    double QuantileSketch::quantile(double q) const {
+        if (count_ == 0 || !(q >= 0 && q <= 1)) {
+            return NAN;
+        }
+        if (q == 0) {
+            return min_;
+        }
+        if (q == 1) {
+            return max_;
+        }
+        // Walk buckets from the most negative value up to the sample of rank q*(n-1)
+        uint64_t rank = (uint64_t)(q * (double)(count_ - 1));
+        uint64_t seen = 0;
+        double result = max_;
+        bool found = false;
+        for (size_t i = negative_.counts.size(); i-- > 0 && !found;) {
+            seen += negative_.counts[i];
+            if (seen > rank) {
+                result = -value(negative_.offset + (int32_t)i);
+                found = true;
+            }
+        }
+        if (!found) {
+            seen += zeros_;
+            if (seen > rank) {
+                result = 0.0;
+                found = true;
+            }
+        }
+        for (size_t i = 0; i < positive_.counts.size() && !found; i++) {
+            seen += positive_.counts[i];
+            if (seen > rank) {
+                result = value(positive_.offset + (int32_t)i);
+                found = true;
+            }
+        }
+        return std::min(std::max(result, min_), max_);
+    }
+}
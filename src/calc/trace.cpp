@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "calc/trace.h"
+
+namespace calc {
+namespace trace {
+
+    static bool initiallyEnabled() {
+        const char* env = getenv("CALC_TRACE");
+        return env && env[0] && strcmp(env, "0") != 0;
+    }
+
+    std::atomic<bool> enabledFlag{initiallyEnabled()};
+
+    namespace {
+        const size_t RING_CAPACITY = 4096; // power of two
+
+        // Single-producer/single-consumer ring: the owning thread pushes, the writer pops.
+        struct Ring {
+            alignas(64) std::atomic<size_t> head{0}; // next slot to write (producer)
+            alignas(64) std::atomic<size_t> tail{0}; // next slot to read (consumer)
+            alignas(64) std::atomic<bool> retired{false};
+            uint32_t thread = 0;
+            Record slots[RING_CAPACITY];
+
+            bool push(const Record& record) {
+                size_t h = head.load(std::memory_order_relaxed);
+                if (h - tail.load(std::memory_order_acquire) == RING_CAPACITY) {
+                    return false;
+                }
+                slots[h & (RING_CAPACITY - 1)] = record;
+                head.store(h + 1, std::memory_order_release);
+                return true;
+            }
+        };
+
+        void printSink(const Record& record, void*) {
+            char line[160];
+            size_t length = format(record, line, sizeof(line));
+            fwrite(line, 1, length, stdout);
+        }
+
+        class Writer {
+        public:
+            ~Writer() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stopping_ = true;
+                }
+                wake_.notify_all();
+                if (thread_.joinable()) {
+                    thread_.join();
+                }
+                drain();
+            }
+
+            std::shared_ptr<Ring> registerThread() {
+                auto ring = std::make_shared<Ring>();
+                std::lock_guard<std::mutex> lock(mutex_);
+                ring->thread = nextThread_++;
+                rings_.push_back(ring);
+                if (!thread_.joinable() && !stopping_) {
+                    thread_ = std::thread([this] { run(); });
+                }
+                return ring;
+            }
+
+            void setSink(Sink sink, void* user) {
+                std::lock_guard<std::mutex> lock(drainMutex_);
+                sink_ = sink ? sink : printSink;
+                user_ = user;
+            }
+
+            void flush() {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (!thread_.joinable()) {
+                    lock.unlock();
+                    drain();
+                    return;
+                }
+                uint64_t target = ++flushRequested_;
+                wake_.notify_all();
+                flushed_.wait(lock, [&] { return flushCompleted_ >= target || stopping_; });
+            }
+
+            std::atomic<uint64_t> dropped{0};
+
+        private:
+            std::mutex mutex_;               // guards rings_, flags and flush counters
+            std::mutex drainMutex_;          // serializes draining and sink changes
+            std::condition_variable wake_;
+            std::condition_variable flushed_;
+            std::vector<std::shared_ptr<Ring>> rings_;
+            std::thread thread_;
+            bool stopping_ = false;
+            uint32_t nextThread_ = 0;
+            uint64_t flushRequested_ = 0;
+            uint64_t flushCompleted_ = 0;
+            Sink sink_ = printSink;
+            void* user_ = nullptr;
+
+            void run() {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (!stopping_) {
+                    wake_.wait_for(lock, std::chrono::milliseconds(10), [this] {
+                        return stopping_ || flushRequested_ > flushCompleted_;
+                    });
+                    uint64_t target = flushRequested_;
+                    lock.unlock();
+                    drain();
+                    lock.lock();
+                    if (target > flushCompleted_) {
+                        flushCompleted_ = target;
+                        flushed_.notify_all();
+                    }
+                }
+            }
+
+            void drain() {
+                std::vector<std::shared_ptr<Ring>> rings;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    rings = rings_;
+                }
+                std::lock_guard<std::mutex> lock(drainMutex_);
+                bool anyRetired = false;
+                for (auto& ring : rings) {
+                    // Read retired before head so records pushed before retirement are seen
+                    bool retired = ring->retired.load(std::memory_order_acquire);
+                    size_t h = ring->head.load(std::memory_order_acquire);
+                    size_t t = ring->tail.load(std::memory_order_relaxed);
+                    for (; t != h; t++) {
+                        sink_(ring->slots[t & (RING_CAPACITY - 1)], user_);
+                    }
+                    ring->tail.store(t, std::memory_order_release);
+                    anyRetired |= retired;
+                }
+                if (sink_ == printSink) {
+                    fflush(stdout);
+                }
+                if (anyRetired) {
+                    std::lock_guard<std::mutex> registryLock(mutex_);
+                    rings_.erase(std::remove_if(rings_.begin(), rings_.end(), [](const std::shared_ptr<Ring>& ring) {
+                        return ring->retired.load(std::memory_order_acquire) &&
+                               ring->tail.load(std::memory_order_relaxed) == ring->head.load(std::memory_order_acquire);
+                    }), rings_.end());
+                }
+            }
+        };
+
+        Writer& writer() {
+            static Writer instance;
+            return instance;
+        }
+
+        // Marks the thread's ring retired on thread exit so the writer can drop it once drained.
+        struct ThreadRing {
+            std::shared_ptr<Ring> ring;
+            ~ThreadRing() {
+                if (ring) {
+                    ring->retired.store(true, std::memory_order_release);
+                }
+            }
+        };
+
+        uint64_t nowNanos() {
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    void enable(bool on) {
+        enabledFlag.store(on, std::memory_order_relaxed);
+        if (!on) {
+            flush();
+        }
+    }
+
+    void setSink(Sink sink, void* user) {
+        writer().setSink(sink, user);
+    }
+
+    void flush() {
+        writer().flush();
+    }
+
+    uint64_t dropped() {
+        return writer().dropped.load(std::memory_order_relaxed);
+    }
+
+    void record(Event event, size_t count, uint8_t arity, double a, double b, const char* name) {
+        static thread_local ThreadRing local;
+        if (!local.ring) {
+            local.ring = writer().registerThread();
+        }
+        Record entry;
+        entry.nanos = nowNanos();
+        entry.thread = local.ring->thread;
+        entry.event = event;
+        entry.arity = arity;
+        entry.name = name;
+        entry.count = count;
+        entry.a = a;
+        entry.b = b;
+        if (!local.ring->push(entry)) {
+            writer().dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    size_t format(const Record& record, char* buffer, size_t size) {
+        int length = 0;
+        if (record.count != 0) {
+            switch (record.event) {
+                case Event::Add: length = snprintf(buffer, size, "calc::Adding %zu pairs\n", record.count); break;
+                case Event::Subtract: length = snprintf(buffer, size, "calc::Subtracting %zu pairs\n", record.count); break;
+                case Event::Multiply: length = snprintf(buffer, size, "calc::Multiplying %zu pairs\n", record.count); break;
+                case Event::Divide: length = snprintf(buffer, size, "calc::Dividing %zu pairs\n", record.count); break;
+                case Event::Power: length = snprintf(buffer, size, "calc::Calculating %zu powers\n", record.count); break;
+                case Event::SquareRoot: length = snprintf(buffer, size, "calc::Calculating %zu square roots\n", record.count); break;
+                case Event::Sum: length = snprintf(buffer, size, "calc::Summing %zu values\n", record.count); break;
+                case Event::Dot: length = snprintf(buffer, size, "calc::Dot product of %zu pairs\n", record.count); break;
+                case Event::Product: length = snprintf(buffer, size, "calc::Multiplying %zu values together\n", record.count); break;
+                case Event::Minimum: length = snprintf(buffer, size, "calc::Finding the minimum of %zu values\n", record.count); break;
+                case Event::Maximum: length = snprintf(buffer, size, "calc::Finding the maximum of %zu values\n", record.count); break;
+                case Event::MatrixMultiply: length = snprintf(buffer, size, "calc::Matrix product of %zu multiply-adds\n", record.count); break;
+                default: length = snprintf(buffer, size, "calc::Batch of %zu\n", record.count); break;
+            }
+        } else {
+            switch (record.event) {
+                case Event::Add: length = snprintf(buffer, size, "calc::Adding %f and %f\n", record.a, record.b); break;
+                case Event::Subtract: length = snprintf(buffer, size, "calc::Subtracting %f from %f\n", record.b, record.a); break;
+                case Event::Multiply: length = snprintf(buffer, size, "calc::Multiplying %f and %f\n", record.a, record.b); break;
+                case Event::Divide: length = snprintf(buffer, size, "calc::Dividing %f by %f\n", record.a, record.b); break;
+                case Event::Power: length = snprintf(buffer, size, "calc::Calculating %f raised to the power of %f\n", record.a, record.b); break;
+                case Event::SquareRoot: length = snprintf(buffer, size, "calc::Calculating square root of %f\n", record.a); break;
+                case Event::DivideByZero: length = snprintf(buffer, size, "Error: Division by zero is not allowed.\n"); break;
+                case Event::NegativeSquareRoot: length = snprintf(buffer, size, "Error: Square root of negative number is not allowed.\n"); break;
+                case Event::Sum:
+                case Event::Dot:
+                case Event::Product:
+                case Event::Minimum:
+                case Event::Maximum:
+                    length = snprintf(buffer, size, "calc::Reducing 0 values\n");
+                    break;
+                case Event::MatrixMultiply:
+                    length = snprintf(buffer, size, "calc::Matrix product of 0 multiply-adds\n");
+                    break;
+                case Event::Call:
+                    if (record.arity == 1) {
+                        length = snprintf(buffer, size, "%s -> %f\n", record.name, record.a);
+                    } else {
+                        length = snprintf(buffer, size, "%s -> %f, %f\n", record.name, record.a, record.b);
+                    }
+                    break;
+            }
+        }
+        if (length < 0) {
+            return 0;
+        }
+        return (size_t)length < size ? (size_t)length : size - 1;
+    }
+}
+}
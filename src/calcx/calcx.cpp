@@ -4,11 +4,16 @@
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_surface.h>
 #include <SDL3/SDL_hints.h>
-#ifdef __linux__
-#include <stdlib.h>  // For setenv on Linux
-#endif
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
 #include "calc/calc.h"
+#include "calc/trace.h"
+#include "calc/expression.h"
 #include "graphics/graphics.h"
+#include "columns.h"
+#include "serve.h"
+#include "stream.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -27,31 +32,31 @@ using namespace graphics;
 using namespace calc;
 
 double addx(double a, double b) {
-    printf("addx -> %f, %f\n", a, b);
+    CALC_TRACE_CALL("addx", a, b);
     return add(a, b);
 }
 
 double subx(double a, double b) {
-    printf("subx -> %f, %f\n", a, b);
+    CALC_TRACE_CALL("subx", a, b);
     return subtract(a, b);
 }
 
 double mulx(double a, double b) {
-    printf("mulx -> %f, %f\n", a, b);
+    CALC_TRACE_CALL("mulx", a, b);
     return multiply(a, b);
 }
 
 double divx(double a, double b) {
-    printf("divx -> %f, %f\n", a, b);
+    CALC_TRACE_CALL("divx", a, b);
     return divide(a, b);
 }
 
 double powx(double base, double exponent) {
-    printf("powx -> %f, %f\n", base, exponent);
+    CALC_TRACE_CALL("powx", base, exponent);
     return power(base, exponent);
 }
 double sqrtx(double value) {
-    printf("sqrtx -> %f\n", value);
+    CALC_TRACE_CALL1("sqrtx", value);
     return squareRoot(value);
 }
 void versionx(void) {
@@ -65,6 +70,9 @@ int main(int argc, char *argv[]) {
         return 0;
     }
     if (argc > 1 && strcmp(argv[1], "--calc") == 0) {
+        if (argc > 2 && strcmp(argv[2], "--trace") == 0) {
+            calc::trace::enable(true);
+        }
         double a = 9.0, b = 3.0;
         printf("Add: %f\n", addx(a, b));
         printf("Subtract: %f\n", subx(a, b));
@@ -72,9 +80,69 @@ int main(int argc, char *argv[]) {
         printf("Divide: %f\n", divx(a, b));
         printf("Power: %f\n", powx(a, b));
         printf("Square Root: %f\n", sqrtx(a));
+        calc::trace::flush();
         versionx();
         return 0;
     }
+    if (argc > 2 && strcmp(argv[1], "--eval") == 0) {
+        // calcx --eval "pow(a,b)/sqrt(c)+d" a=9 b=3 c=16 d=1
+        Expression expression;
+        std::string error;
+        if (!expression.compile(argv[2], &error)) {
+            fprintf(stderr, "Invalid expression: %s\n", error.c_str());
+            return 1;
+        }
+        std::vector<double> values(expression.variables().size(), 0.0);
+        std::vector<bool> bound(values.size(), false);
+        for (int i = 3; i < argc; i++) {
+            const char* eq = strchr(argv[i], '=');
+            if (!eq) {
+                fprintf(stderr, "Expected name=value, got '%s'\n", argv[i]);
+                return 1;
+            }
+            int index = expression.variableIndex(std::string(argv[i], eq - argv[i]));
+            if (index >= 0) {
+                values[index] = atof(eq + 1);
+                bound[index] = true;
+            }
+        }
+        for (size_t i = 0; i < values.size(); i++) {
+            if (!bound[i]) {
+                fprintf(stderr, "Missing value for '%s'\n", expression.variables()[i].c_str());
+                return 1;
+            }
+        }
+        printf("%.17g\n", expression.evaluate(values));
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--stream") == 0) {
+        // calcx --stream [file|-] [--threads N] < ops.txt > results.txt
+        const char* path = nullptr;
+        unsigned threads = 0;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                threads = (unsigned)atoi(argv[++i]);
+            } else if (!path) {
+                path = argv[i];
+            } else {
+                fprintf(stderr, "Unexpected argument '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        return runStream(path, threads);
+    }
+    if (argc > 1 && strcmp(argv[1], "--dataset") == 0) {
+        // calcx --dataset points.csv "r = sqrt(x*x + y*y)" > r.csv
+        return runDataset(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "--serve") == 0) {
+        // calcx --serve /tmp/calc.sock [--threads N]
+        return runServe(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "--load") == 0) {
+        // calcx --load /tmp/calc.sock --connections 8 --batch 64 --seconds 10
+        return runLoad(argc - 2, argv + 2);
+    }
     if (argc > 1 && strcmp(argv[1], "--graphics") == 0) {
         printf("Initializing SDL for graphics...\n");
         
@@ -170,6 +238,8 @@ int main(int argc, char *argv[]) {
             auto earth = shapeManager.createCircle(600, 350, 20, EARTH_COLOR, earthOptions);
             auto moon = shapeManager.createCircle(450, 400, 8, MOON_COLOR, moonOptions);
             struct Ray rays[RAY_COUNT]; // Initialize array to zero
+            int rayLengths[RAY_COUNT] = {0}; // Steps each ray took last frame
+            double raysX = 0, raysY = 0; // Sun position the rays were last traced from
             
             // Moon orbital parameters
             double planet_angular_speed = 0.025; // Radians per frame (orbital speed)
@@ -193,6 +263,7 @@ int main(int argc, char *argv[]) {
                         printf("Window resized to %dx%d\n", e.window.data1, e.window.data2);
                         // Re-acquire surface after resize
                         surface = SDL_GetWindowSurface(window);
+                        shapeManager.invalidateAll();
                         if (!surface) {
                             fprintf(stderr, "Failed to get window surface after resize: %s\n", SDL_GetError());
                         }
@@ -244,13 +315,39 @@ int main(int argc, char *argv[]) {
                 graphics::generateRays(*sun, rays);
                 
                 if (surface) {
-                    SDL_FillSurfaceRect(surface, NULL, BLACK);
-                    graphics::drawRays(surface, *sun, rays, RAY_COLOR, planets);
-                    
-                    // Use shape manager to draw all shapes
-                    shapeManager.drawAll(surface);
-                    
-                    SDL_UpdateWindowSurface(window);
+                    // Rays only need redrawing where they got longer or shorter, unless
+                    // the sun moved them all
+                    int lengths[RAY_COUNT];
+                    graphics::traceRays(rays, planets, surface->w, surface->h, lengths);
+                    if (sun->getX() != raysX || sun->getY() != raysY) {
+                        shapeManager.invalidateAll();
+                        raysX = sun->getX();
+                        raysY = sun->getY();
+                    } else {
+                        for (int i = 0; i < RAY_COUNT; i++) {
+                            if (lengths[i] != rayLengths[i]) {
+                                shapeManager.invalidate(graphics::rayBounds(rays[i], std::min(lengths[i], rayLengths[i]), std::max(lengths[i], rayLengths[i])));
+                            }
+                        }
+                    }
+                    std::copy(lengths, lengths + RAY_COUNT, rayLengths);
+
+                    // Redraw and present only what changed
+                    SDL_Rect screen = {0, 0, surface->w, surface->h};
+                    std::vector<SDL_Rect> damage = shapeManager.takeDamage(screen);
+                    if (!damage.empty()) {
+                        {
+                            // One lock for the whole frame; released before presenting
+                            Canvas canvas(surface);
+                            for (const SDL_Rect& rect : damage) {
+                                canvas.setClip(&rect);
+                                canvas.clear(BLACK);
+                                graphics::drawRays(canvas, rays, rayLengths, RAY_COLOR);
+                                shapeManager.drawAll(canvas, DrawOptions());
+                            }
+                        }
+                        SDL_UpdateWindowSurfaceRects(window, damage.data(), (int)damage.size());
+                    }
                 } else {
                     fprintf(stderr, "Failed to get window surface: %s\n", SDL_GetError());
                 }
@@ -265,6 +362,6 @@ int main(int argc, char *argv[]) {
         return 0;
     }
     
-    printf("Usage: %s [--version|--calc|--graphics]\n", argv[0]);
+    printf("Usage: %s [--version|--calc [--trace]|--eval <expr> [name=value...]|--stream [file] [--threads N]|--dataset <file> <expr> [options]|--serve <socket> [--threads N]|--load <socket> [options]|--graphics]\n", argv[0]);
     return 0;
 }
\ No newline at end of file
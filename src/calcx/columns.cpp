@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <charconv>
+#include <string>
+#include <vector>
+#include "calc/dataset.h"
+#include "calc/expression.h"
+#include "columns.h"
+
+namespace {
+    const size_t FLUSH_SIZE = (size_t)1 << 20;
+
+    bool endsWith(const std::string& text, const char* suffix) {
+        size_t length = strlen(suffix);
+        if (text.size() < length) {
+            return false;
+        }
+        for (size_t i = 0; i < length; i++) {
+            char c = text[text.size() - length + i];
+            if (c >= 'A' && c <= 'Z') {
+                c = (char)(c - 'A' + 'a');
+            }
+            if (c != suffix[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<std::string> split(const char* list) {
+        std::vector<std::string> names;
+        for (const char* p = list;;) {
+            const char* comma = strchr(p, ',');
+            names.emplace_back(p, comma ? (size_t)(comma - p) : strlen(p));
+            if (!comma) {
+                return names;
+            }
+            p = comma + 1;
+        }
+    }
+
+    // "name = expression" or just "expression"; a leading identifier followed by a single
+    // '=' names the output column.
+    void splitAssignment(const std::string& text, std::string& name, std::string& expression) {
+        size_t equals = text.find('=');
+        if (equals != std::string::npos && equals + 1 < text.size() && text[equals + 1] != '=') {
+            size_t first = text.find_first_not_of(" \t");
+            size_t last = text.find_last_not_of(" \t", equals - 1);
+            if (first != std::string::npos && last != std::string::npos && first <= last) {
+                std::string candidate = text.substr(first, last - first + 1);
+                bool identifier = true;
+                for (char c : candidate) {
+                    identifier = identifier && (c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'));
+                }
+                if (identifier) {
+                    name = candidate;
+                    expression = text.substr(equals + 1);
+                    return;
+                }
+            }
+        }
+        name = "result";
+        expression = text;
+    }
+
+    void appendNumber(std::string& out, double value) {
+        char buffer[64];
+#if defined(__cpp_lib_to_chars)
+        std::to_chars_result written = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, written.ptr);
+#else
+        int length = snprintf(buffer, sizeof(buffer), "%.17g", value);
+        out.append(buffer, (size_t)length);
+#endif
+    }
+}
+
+int runDataset(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: calcx --dataset <file> \"[name =] expression\" [--columns a,b,...] [--layout rows|columns] [--output file] [--threads N]\n");
+        return 1;
+    }
+    std::string path = argv[0];
+    std::string name;
+    std::string source;
+    splitAssignment(argv[1], name, source);
+
+    std::vector<std::string> columns;
+    calc::Dataset::Layout layout = calc::Dataset::Layout::Rows;
+    const char* outputPath = nullptr;
+    calc::DatasetOptions options;
+    for (int i = 2; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--columns") == 0 && hasValue) {
+            columns = split(argv[++i]);
+        } else if (strcmp(argv[i], "--layout") == 0 && hasValue) {
+            const char* value = argv[++i];
+            if (strcmp(value, "rows") != 0 && strcmp(value, "columns") != 0) {
+                fprintf(stderr, "Unknown layout '%s'; expected rows or columns\n", value);
+                return 1;
+            }
+            layout = strcmp(value, "rows") == 0 ? calc::Dataset::Layout::Rows : calc::Dataset::Layout::Columns;
+        } else if (strcmp(argv[i], "--output") == 0 && hasValue) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            options.threads = (unsigned)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Unexpected argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+
+    calc::Expression expression;
+    std::string error;
+    if (!expression.compile(source, &error)) {
+        fprintf(stderr, "Invalid expression: %s\n", error.c_str());
+        return 1;
+    }
+    calc::Dataset dataset;
+    bool opened = endsWith(path, ".csv") ? dataset.openCsv(path, &error) : dataset.openBinary(path, columns, layout, &error);
+    if (!opened) {
+        fprintf(stderr, "Cannot read dataset: %s\n", error.c_str());
+        return 1;
+    }
+
+    for (const std::string& variable : expression.variables()) {
+        if (dataset.columnIndex(variable) < 0) {
+            fprintf(stderr, "No column named '%s'\n", variable.c_str());
+            return 1;
+        }
+    }
+
+    FILE* out = stdout;
+    if (outputPath) {
+        out = fopen(outputPath, "wb");
+        if (!out) {
+            fprintf(stderr, "Cannot create '%s'\n", outputPath);
+            return 1;
+        }
+    }
+    std::string text;
+    if (!outputPath) {
+        text = name + "\n";
+    }
+    bool writeFailed = false;
+    calc::DatasetSink sink = [&](size_t, const double* values, size_t count) {
+        if (outputPath) {
+            writeFailed = fwrite(values, sizeof(double), count, out) != count;
+            return !writeFailed;
+        }
+        for (size_t i = 0; i < count; i++) {
+            appendNumber(text, values[i]);
+            text.push_back('\n');
+            if (text.size() >= FLUSH_SIZE) {
+                writeFailed = fwrite(text.data(), 1, text.size(), out) != text.size();
+                text.clear();
+                if (writeFailed) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    bool ok = calc::evaluate(expression, dataset, sink, options, &error);
+    if (!text.empty() && !writeFailed) {
+        writeFailed = fwrite(text.data(), 1, text.size(), out) != text.size();
+    }
+    if (fflush(out) != 0) {
+        writeFailed = true;
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    if (writeFailed) {
+        fprintf(stderr, "Error writing results\n");
+        return 1;
+    }
+    if (!ok) {
+        fprintf(stderr, "Evaluation failed: %s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
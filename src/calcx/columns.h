@@ -0,0 +1,14 @@
+#pragma once
+
+// calcx --dataset: evaluates an expression over the columns of a CSV or raw binary file.
+//
+//   calcx --dataset <file> "[name =] expression" [--columns a,b,...] [--layout rows|columns]
+//                   [--output results.bin] [--threads N]
+//
+// Files ending in .csv take their column names from the header line; anything else is
+// read as raw doubles and needs --columns, with --layout saying whether values are
+// stored as records (rows, the default) or column after column. Results go to stdout as
+// a one-column CSV headed by name ("result" when the expression has no "name ="), or
+// with --output to a raw file of doubles. argv holds the arguments after --dataset.
+// Returns the process exit code.
+int runDataset(int argc, char* argv[]);
@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include "calc/calc.h"
+#include "calc/stats.h"
+#include "serve.h"
+
+#ifndef _WIN32
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const char* const OPERATION_NAMES[serve::OperationCount] = {
+        "add", "subtract", "multiply", "divide", "power", "squareRoot"
+    };
+
+    int findOperation(const char* name) {
+        for (int i = 0; i < serve::OperationCount; i++) {
+            if (strcmp(OPERATION_NAMES[i], name) == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    int connectTo(const char* path) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(address.sun_path)) {
+            return -1;
+        }
+        strcpy(address.sun_path, path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (const sockaddr*)&address, sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    struct Client {
+        int fd = -1;
+        calc::QuantileSketch latency{0.005};    // nanoseconds
+        uint64_t requests = 0;
+        uint64_t mismatches = 0;
+        bool failed = false;
+    };
+
+    // One connection: the same request is sent over and over with `depth` in flight, and
+    // every reply is compared bit for bit with the local calc result.
+    void drive(Client& client, uint16_t operation, uint32_t batch, unsigned depth, Clock::time_point deadline, unsigned seed) {
+        uint32_t arity = serve::arity(operation);
+        std::vector<double> operands((size_t)batch * arity);
+        uint64_t state = 0x9E3779B97F4A7C15ull * (seed + 1);
+        for (double& value : operands) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            value = (double)(state >> 11) * (1.0 / 9007199254740992.0) * 100.0;
+        }
+        std::vector<double> expected(batch);
+        if (arity == 1) {
+            calc::squareRoot(operands.data(), expected.data(), batch);
+        } else {
+            const double* a = operands.data();
+            const double* b = operands.data() + batch;
+            switch (operation) {
+                case serve::Add: calc::add(a, b, expected.data(), batch); break;
+                case serve::Subtract: calc::subtract(a, b, expected.data(), batch); break;
+                case serve::Multiply: calc::multiply(a, b, expected.data(), batch); break;
+                case serve::Divide: calc::divide(a, b, expected.data(), batch); break;
+                default: calc::power(a, b, expected.data(), batch); break;
+            }
+        }
+
+        serve::RequestHeader header = {};
+        header.size = (uint32_t)(operands.size() * sizeof(double));
+        header.operation = operation;
+        header.count = batch;
+        std::vector<char> request(sizeof(header) + header.size);
+        memcpy(request.data() + sizeof(header), operands.data(), header.size);
+        std::vector<char> reply(batch * sizeof(double));
+        std::vector<Clock::time_point> sent(depth);
+
+        // Sends and receives interleave on a non-blocking socket: the server stops reading
+        // while replies back up, so writing every request before reading could deadlock.
+        int flags = fcntl(client.fd, F_GETFL);
+        if (flags < 0 || fcntl(client.fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+            client.failed = true;
+            return;
+        }
+
+        uint32_t nextId = 0;
+        uint32_t inFlight = 0;      // posted and not yet answered
+        uint32_t unsent = 0;        // posted and not yet fully written, the oldest first
+        size_t sendOffset = 0;      // bytes of the oldest unsent request written so far
+        serve::ResponseHeader response;
+        size_t receiveOffset = 0;   // bytes of the current reply read so far, header included
+        auto post = [&]() {
+            sent[nextId % depth] = Clock::now();
+            nextId++;
+            inFlight++;
+            unsent++;
+        };
+
+        // Writes until the socket is full or nothing is left; false if the connection broke.
+        auto flush = [&]() {
+            while (unsent > 0) {
+                if (sendOffset == 0) {
+                    header.id = nextId - unsent;
+                    memcpy(request.data(), &header, sizeof(header));
+                }
+                ssize_t written = send(client.fd, request.data() + sendOffset, request.size() - sendOffset, MSG_NOSIGNAL);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return errno == EAGAIN || errno == EWOULDBLOCK;
+                }
+                sendOffset += (size_t)written;
+                if (sendOffset == request.size()) {
+                    sendOffset = 0;
+                    unsent--;
+                }
+            }
+            return true;
+        };
+
+        // Checks a complete reply and posts the next request while time remains.
+        auto complete = [&]() {
+            Clock::time_point now = Clock::now();
+            uint32_t id = nextId - inFlight;
+            inFlight--;
+            client.latency.add((double)std::chrono::duration_cast<std::chrono::nanoseconds>(now - sent[id % depth]).count());
+            client.requests++;
+            if (response.id != id || response.status != serve::Ok || response.count != batch ||
+                memcmp(reply.data(), expected.data(), reply.size()) != 0) {
+                client.mismatches++;
+            }
+            if (now < deadline) {
+                post();
+            }
+        };
+
+        // Reads until the socket is empty; false if the connection broke or sent a bad frame.
+        auto drain = [&]() {
+            for (;;) {
+                char* target = (char*)&response + receiveOffset;
+                size_t wanted = sizeof(response) - receiveOffset;
+                if (receiveOffset >= sizeof(response)) {
+                    target = reply.data() + (receiveOffset - sizeof(response));
+                    wanted = sizeof(response) + response.size - receiveOffset;
+                }
+                ssize_t got = recv(client.fd, target, wanted, 0);
+                if (got <= 0) {
+                    if (got < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    return got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+                }
+                receiveOffset += (size_t)got;
+                if (receiveOffset < sizeof(response)) {
+                    continue;
+                }
+                if (response.size != response.count * sizeof(double) || response.count > batch || inFlight == unsent) {
+                    return false;
+                }
+                if (receiveOffset == sizeof(response) + response.size) {
+                    receiveOffset = 0;
+                    complete();
+                }
+            }
+        };
+
+        for (unsigned i = 0; i < depth; i++) {
+            post();
+        }
+        while (inFlight > 0) {
+            pollfd ready = {client.fd, (short)(unsent > 0 ? POLLIN | POLLOUT : POLLIN), 0};
+            if (poll(&ready, 1, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                client.failed = true;
+                return;
+            }
+            if ((ready.revents & (POLLERR | POLLNVAL)) ||
+                ((ready.revents & POLLOUT) && !flush()) ||
+                ((ready.revents & (POLLIN | POLLHUP)) && !drain())) {
+                client.failed = true;
+                return;
+            }
+        }
+    }
+}
+
+int runLoad(int argc, char* argv[]) {
+    if (argc < 1) {
+        fprintf(stderr, "Usage: calcx --load <socket> [--connections N] [--seconds S] [--batch B] [--depth D] [--op name]\n");
+        return 1;
+    }
+    const char* path = argv[0];
+    unsigned connections = 0;
+    double seconds = 5;
+    unsigned batch = 64;
+    unsigned depth = 1;
+    int operation = serve::Add;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--connections") == 0 && hasValue) {
+            connections = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && hasValue) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && hasValue) {
+            batch = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--depth") == 0 && hasValue) {
+            depth = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--op") == 0 && hasValue) {
+            operation = findOperation(argv[++i]);
+            if (operation < 0) {
+                fprintf(stderr, "Unknown operation '%s'\n", argv[i]);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Unexpected argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (connections == 0) {
+        connections = std::thread::hardware_concurrency();
+        connections = connections ? connections : 1;
+    }
+    if (batch == 0 || batch > serve::MAX_COUNT || depth == 0 || !(seconds > 0)) {
+        fprintf(stderr, "--batch must be 1..%u, --depth at least 1 and --seconds positive\n", serve::MAX_COUNT);
+        return 1;
+    }
+
+    // Connect everyone before the clock starts
+    std::vector<Client> clients(connections);
+    for (Client& client : clients) {
+        client.fd = connectTo(path);
+        if (client.fd < 0) {
+            fprintf(stderr, "Cannot connect to '%s': %s\n", path, strerror(errno));
+            for (Client& opened : clients) {
+                if (opened.fd >= 0) {
+                    close(opened.fd);
+                }
+            }
+            return 1;
+        }
+    }
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < connections; i++) {
+        threads.emplace_back(drive, std::ref(clients[i]), (uint16_t)operation, (uint32_t)batch, depth, deadline, i);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    calc::QuantileSketch latency(0.005);
+    uint64_t requests = 0;
+    uint64_t mismatches = 0;
+    unsigned failures = 0;
+    for (Client& client : clients) {
+        close(client.fd);
+        latency.merge(client.latency);
+        requests += client.requests;
+        mismatches += client.mismatches;
+        failures += client.failed ? 1 : 0;
+    }
+
+    printf("%s x %u, %u connection%s, depth %u: %llu requests in %.2f s\n", OPERATION_NAMES[operation], batch,
+           connections, connections == 1 ? "" : "s", depth, (unsigned long long)requests, elapsed);
+    printf("throughput: %.0f requests/s, %.2f M operations/s\n", requests / elapsed, requests * (double)batch / elapsed * 1e-6);
+    if (requests > 0) {
+        printf("latency us: p50 %.1f  p99 %.1f  p999 %.1f  max %.1f\n", latency.quantile(0.5) * 1e-3,
+               latency.quantile(0.99) * 1e-3, latency.quantile(0.999) * 1e-3, latency.quantile(1.0) * 1e-3);
+    }
+    if (failures || mismatches) {
+        fprintf(stderr, "%u connection%s failed, %llu repl%s did not match the local results\n", failures,
+                failures == 1 ? "" : "s", (unsigned long long)mismatches, mismatches == 1 ? "y" : "ies");
+        return 1;
+    }
+    return 0;
+}
+
+#else
+
+int runLoad(int, char*[]) {
+    fprintf(stderr, "calcx --load needs Unix domain sockets and is not available on Windows\n");
+    return 1;
+}
+
+#endif
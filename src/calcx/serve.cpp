@@ -0,0 +1,430 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include "calc/calc.h"
+#include "serve.h"
+
+#ifdef __linux__
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE 0
+#endif
+
+namespace {
+    // Replies queued beyond this stop a connection's reads until the client catches up
+    const size_t OUTPUT_LIMIT = (size_t)4 << 20;
+    const size_t INITIAL_BUFFER = (size_t)64 << 10;
+    const int MAX_EVENTS = 256;
+
+    using BatchFunction = void (*)(const double*, const double*, double*, size_t);
+
+    const BatchFunction OPERATIONS[serve::OperationCount] = {
+        [](const double* a, const double* b, double* out, size_t n) { calc::add(a, b, out, n); },
+        [](const double* a, const double* b, double* out, size_t n) { calc::subtract(a, b, out, n); },
+        [](const double* a, const double* b, double* out, size_t n) { calc::multiply(a, b, out, n); },
+        [](const double* a, const double* b, double* out, size_t n) { calc::divide(a, b, out, n); },
+        [](const double* a, const double* b, double* out, size_t n) { calc::power(a, b, out, n); },
+        [](const double* a, const double*, double* out, size_t n) { calc::squareRoot(a, out, n); },
+    };
+
+    // Byte queue: data is read from begin, appended at end. The allocation comes from
+    // malloc, and every frame is a multiple of 8 bytes, so operands and results in it
+    // are aligned for double.
+    struct Buffer {
+        char* data = nullptr;
+        size_t begin = 0;
+        size_t end = 0;
+        size_t capacity = 0;
+
+        ~Buffer() { free(data); }
+
+        size_t size() const { return end - begin; }
+
+        // Makes room for extra bytes after end; false when out of memory.
+        bool reserve(size_t extra) {
+            if (begin == end) {
+                begin = end = 0;
+            }
+            if (end + extra <= capacity) {
+                return true;
+            }
+            if (begin > 0) {
+                memmove(data, data + begin, end - begin);
+                end -= begin;
+                begin = 0;
+                if (end + extra <= capacity) {
+                    return true;
+                }
+            }
+            size_t grown = capacity ? capacity : INITIAL_BUFFER;
+            while (grown < end + extra) {
+                grown *= 2;
+            }
+            char* resized = (char*)realloc(data, grown);
+            if (!resized) {
+                return false;
+            }
+            data = resized;
+            capacity = grown;
+            return true;
+        }
+    };
+
+    struct Connection {
+        int fd;
+        size_t slot;            // index in its loop's connection list
+        Buffer in;
+        Buffer out;
+        bool reading = true;    // false while replies back up past OUTPUT_LIMIT
+        bool writing = false;   // EPOLLOUT armed
+    };
+
+    struct Totals {
+        std::atomic<uint64_t> connections{0};
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> operations{0};
+    };
+
+    int stopPipe[2] = {-1, -1};
+
+    void onSignal(int) {
+        char byte = 0;
+        ssize_t ignored = write(stopPipe[1], &byte, 1);
+        (void)ignored;
+    }
+
+    // The stop pipe is never drained, so once written it wakes every loop.
+    char stopToken;
+
+    class EventLoop {
+    public:
+        EventLoop(int listener, Totals& totals) : listener_(listener), totals_(totals) {}
+
+        ~EventLoop() {
+            for (std::unique_ptr<Connection>& connection : connections_) {
+                close(connection->fd);
+            }
+            if (epoll_ >= 0) {
+                close(epoll_);
+            }
+        }
+
+        bool open() {
+            epoll_ = epoll_create1(EPOLL_CLOEXEC);
+            if (epoll_ < 0) {
+                return false;
+            }
+            // EPOLLEXCLUSIVE wakes one loop per incoming connection instead of all of them
+            epoll_event event = {};
+            event.events = EPOLLIN | EPOLLEXCLUSIVE;
+            event.data.ptr = nullptr;
+            if (epoll_ctl(epoll_, EPOLL_CTL_ADD, listener_, &event) != 0) {
+                return false;
+            }
+            event.events = EPOLLIN;
+            event.data.ptr = &stopToken;
+            return epoll_ctl(epoll_, EPOLL_CTL_ADD, stopPipe[0], &event) == 0;
+        }
+
+        void run() {
+            epoll_event events[MAX_EVENTS];
+            for (;;) {
+                int ready = epoll_wait(epoll_, events, MAX_EVENTS, -1);
+                if (ready < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    perror("epoll_wait");
+                    return;
+                }
+                for (int i = 0; i < ready; i++) {
+                    void* target = events[i].data.ptr;
+                    if (target == &stopToken) {
+                        return;
+                    }
+                    if (!target) {
+                        accept();
+                        continue;
+                    }
+                    Connection* connection = (Connection*)target;
+                    uint32_t flags = events[i].events;
+                    bool open = true;
+                    if (flags & EPOLLOUT) {
+                        open = flush(connection);
+                    }
+                    if (open && (flags & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                        open = receive(connection);
+                    }
+                    if (!open) {
+                        drop(connection);
+                    }
+                }
+            }
+        }
+
+    private:
+        int listener_;
+        int epoll_ = -1;
+        Totals& totals_;
+        std::vector<std::unique_ptr<Connection>> connections_;
+
+        void accept() {
+            for (;;) {
+                int fd = accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) {
+                    // EAGAIN: another loop took it, or the backlog is empty
+                    return;
+                }
+                std::unique_ptr<Connection> connection(new Connection());
+                connection->fd = fd;
+                connection->slot = connections_.size();
+                epoll_event event = {};
+                event.events = EPOLLIN;
+                event.data.ptr = connection.get();
+                if (epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) != 0) {
+                    close(fd);
+                    continue;
+                }
+                connections_.push_back(std::move(connection));
+                totals_.connections++;
+            }
+        }
+
+        void drop(Connection* connection) {
+            epoll_ctl(epoll_, EPOLL_CTL_DEL, connection->fd, nullptr);
+            close(connection->fd);
+            size_t slot = connection->slot;
+            connections_[slot].swap(connections_.back());
+            connections_[slot]->slot = slot;
+            connections_.pop_back();
+        }
+
+        void watch(Connection* connection, bool reading, bool writing) {
+            if (connection->reading == reading && connection->writing == writing) {
+                return;
+            }
+            connection->reading = reading;
+            connection->writing = writing;
+            epoll_event event = {};
+            event.events = (reading ? (uint32_t)EPOLLIN : 0u) | (writing ? (uint32_t)EPOLLOUT : 0u);
+            event.data.ptr = connection;
+            epoll_ctl(epoll_, EPOLL_CTL_MOD, connection->fd, &event);
+        }
+
+        // Reads what is available, answers every complete request in it, and starts
+        // sending the replies. Returns false when the connection should be closed.
+        bool receive(Connection* connection) {
+            Buffer& in = connection->in;
+            if (!in.reserve(INITIAL_BUFFER)) {
+                return false;
+            }
+            ssize_t got = read(connection->fd, in.data + in.end, in.capacity - in.end);
+            if (got == 0) {
+                return false;
+            }
+            if (got < 0) {
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            }
+            in.end += (size_t)got;
+
+            while (in.size() >= sizeof(serve::RequestHeader)) {
+                serve::RequestHeader header;
+                memcpy(&header, in.data + in.begin, sizeof(header));
+                if (header.size % 8 != 0 || header.size > 2 * sizeof(double) * (size_t)serve::MAX_COUNT) {
+                    return false;
+                }
+                size_t frame = sizeof(header) + header.size;
+                if (in.size() < frame) {
+                    // Room for the rest of a large request
+                    if (!in.reserve(frame - in.size())) {
+                        return false;
+                    }
+                    break;
+                }
+                if (!answer(connection, header, (const double*)(in.data + in.begin + sizeof(header)))) {
+                    return false;
+                }
+                in.begin += frame;
+            }
+            return flush(connection);
+        }
+
+        bool answer(Connection* connection, const serve::RequestHeader& request, const double* operands) {
+            serve::ResponseHeader response;
+            response.id = request.id;
+            response.status = serve::Ok;
+            response.count = request.count;
+            if (request.operation >= serve::OperationCount) {
+                response.status = serve::UnknownOperation;
+            } else if (request.count > serve::MAX_COUNT ||
+                       request.size != (uint64_t)request.count * serve::arity(request.operation) * sizeof(double)) {
+                response.status = serve::BadSize;
+            }
+            if (response.status != serve::Ok) {
+                response.count = 0;
+            }
+            response.size = response.count * (uint32_t)sizeof(double);
+
+            Buffer& out = connection->out;
+            if (!out.reserve(sizeof(response) + response.size)) {
+                return false;
+            }
+            memcpy(out.data + out.end, &response, sizeof(response));
+            if (response.count > 0) {
+                size_t n = response.count;
+                OPERATIONS[request.operation](operands, operands + n, (double*)(out.data + out.end + sizeof(response)), n);
+            }
+            out.end += sizeof(response) + response.size;
+            totals_.requests.fetch_add(1, std::memory_order_relaxed);
+            totals_.operations.fetch_add(response.count, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Writes queued replies until the socket is full, then waits for EPOLLOUT.
+        bool flush(Connection* connection) {
+            Buffer& out = connection->out;
+            while (out.size() > 0) {
+                ssize_t sent = send(connection->fd, out.data + out.begin, out.size(), MSG_NOSIGNAL);
+                if (sent < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                        return false;
+                    }
+                    break;
+                }
+                out.begin += (size_t)sent;
+            }
+            bool pending = out.size() > 0;
+            watch(connection, out.size() < OUTPUT_LIMIT, pending);
+            return true;
+        }
+    };
+
+    int listen(const char* path) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(address.sun_path)) {
+            fprintf(stderr, "Socket path '%s' is too long\n", path);
+            return -1;
+        }
+        strcpy(address.sun_path, path);
+
+        // A socket file left by a server that is gone is replaced; a live one is not
+        struct stat info;
+        if (lstat(path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+            int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            bool live = probe >= 0 && connect(probe, (const sockaddr*)&address, sizeof(address)) == 0;
+            if (probe >= 0) {
+                close(probe);
+            }
+            if (live) {
+                fprintf(stderr, "A server is already listening on '%s'\n", path);
+                return -1;
+            }
+            unlink(path);
+        }
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            perror("socket");
+            return -1;
+        }
+        if (bind(fd, (const sockaddr*)&address, sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+            fprintf(stderr, "Cannot listen on '%s': %s\n", path, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+int runServe(int argc, char* argv[]) {
+    if (argc < 1) {
+        fprintf(stderr, "Usage: calcx --serve <socket> [--threads N]\n");
+        return 1;
+    }
+    const char* path = argv[0];
+    unsigned threads = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = (unsigned)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Unexpected argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+        threads = threads ? threads : 1;
+    }
+
+    if (pipe2(stopPipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        perror("pipe2");
+        return 1;
+    }
+    int listener = listen(path);
+    if (listener < 0) {
+        return 1;
+    }
+    struct sigaction action = {};
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    Totals totals;
+    std::vector<std::unique_ptr<EventLoop>> loops;
+    for (unsigned i = 0; i < threads; i++) {
+        loops.emplace_back(new EventLoop(listener, totals));
+        if (!loops.back()->open()) {
+            perror("epoll");
+            close(listener);
+            unlink(path);
+            return 1;
+        }
+    }
+    fprintf(stderr, "Serving on '%s' with %u event loop%s\n", path, threads, threads == 1 ? "" : "s");
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++) {
+        workers.emplace_back([&loops, i] { loops[i]->run(); });
+    }
+    loops[0]->run();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    loops.clear();
+    close(listener);
+    unlink(path);
+
+    fprintf(stderr, "Served %llu requests (%llu operations) on %llu connections\n",
+            (unsigned long long)totals.requests.load(), (unsigned long long)totals.operations.load(),
+            (unsigned long long)totals.connections.load());
+    return 0;
+}
+
+#else
+
+int runServe(int, char*[]) {
+    fprintf(stderr, "calcx --serve needs epoll and is only available on Linux\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+// calcx --serve: answers batches of calc operations over a local Unix domain socket, so
+// processes on one host can share a single calc instead of linking their own.
+//
+//   calcx --serve <socket> [--threads N]
+//   calcx --load <socket> [--connections N] [--seconds S] [--batch B] [--depth D] [--op name]
+//
+// The protocol is a stream of frames in native byte order (both ends share a host). A
+// request is a RequestHeader followed by count doubles of first operands and, for binary
+// operations, count doubles of second operands; the reply is a ResponseHeader with the
+// request's id followed by count results, computed with one call to the calc batch
+// function. Requests on one connection are answered in order, and clients may pipeline
+// them. A request with an unknown operation or a size that does not match its count gets
+// an error status and no results; a frame larger than MAX_COUNT operations, or whose size
+// is not a multiple of 8, closes the connection.
+namespace serve {
+    const uint32_t MAX_COUNT = 1u << 20;
+
+    enum Operation : uint16_t {
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Power,
+        SquareRoot,
+        OperationCount
+    };
+
+    enum Status : uint32_t {
+        Ok,
+        UnknownOperation,
+        BadSize
+    };
+
+    struct RequestHeader {
+        uint32_t size;          // bytes of operands after the header
+        uint32_t id;            // echoed in the response
+        uint16_t operation;     // Operation
+        uint16_t reserved;
+        uint32_t count;
+    };
+
+    struct ResponseHeader {
+        uint32_t size;          // bytes of results after the header, count * 8
+        uint32_t id;
+        uint32_t status;        // Status
+        uint32_t count;
+    };
+
+    static_assert(sizeof(RequestHeader) == 16 && sizeof(ResponseHeader) == 16, "frames keep operands 8-byte aligned");
+
+    // Operands per element: 1 for SquareRoot, 2 otherwise.
+    inline uint32_t arity(uint16_t operation) {
+        return operation == SquareRoot ? 1 : 2;
+    }
+}
+
+// Runs one epoll event loop per thread (threads = 0: one per hardware thread) sharing the
+// listening socket, until SIGINT or SIGTERM. Each connection stays on the loop that
+// accepted it. Returns the process exit code.
+int runServe(int argc, char* argv[]);
+
+// Load generator for runServe: keeps depth requests of batch operations in flight on
+// each connection for the given time, checks every result against the local calc, and
+// reports throughput and p50/p99/p999 latency. Returns the process exit code.
+int runLoad(int argc, char* argv[]);
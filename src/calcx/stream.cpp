@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "calc/calc.h"
+#include "calc/expression.h"
+#include "stream.h"
+
+namespace {
+    // Input is handed to threads in chunks of about this many bytes, cut after a newline
+    const size_t CHUNK_SIZE = (size_t)4 << 20;
+
+    struct Operation {
+        const char* name;
+        int arity;
+        double (*binary)(double, double);
+        double (*unary)(double);
+    };
+
+    const Operation OPERATIONS[] = {
+        {"add", 2, [](double a, double b) { return calc::add(a, b); }, nullptr},
+        {"sub", 2, [](double a, double b) { return calc::subtract(a, b); }, nullptr},
+        {"subtract", 2, [](double a, double b) { return calc::subtract(a, b); }, nullptr},
+        {"mul", 2, [](double a, double b) { return calc::multiply(a, b); }, nullptr},
+        {"multiply", 2, [](double a, double b) { return calc::multiply(a, b); }, nullptr},
+        {"div", 2, [](double a, double b) { return calc::divide(a, b); }, nullptr},
+        {"divide", 2, [](double a, double b) { return calc::divide(a, b); }, nullptr},
+        {"pow", 2, [](double a, double b) { return calc::power(a, b); }, nullptr},
+        {"power", 2, [](double a, double b) { return calc::power(a, b); }, nullptr},
+        {"sqrt", 1, nullptr, [](double a) { return calc::squareRoot(a); }},
+        {"squareRoot", 1, nullptr, [](double a) { return calc::squareRoot(a); }},
+    };
+
+    const Operation* findOperation(const char* name, size_t length) {
+        for (const Operation& op : OPERATIONS) {
+            if (strlen(op.name) == length && memcmp(op.name, name, length) == 0) {
+                return &op;
+            }
+        }
+        return nullptr;
+    }
+
+    inline bool isSpace(char c) {
+        return c == ' ' || c == '\t';
+    }
+
+    inline bool isLetter(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    inline const char* skipSpaces(const char* p, const char* end) {
+        while (p < end && isSpace(*p)) {
+            p++;
+        }
+        return p;
+    }
+
+    bool parseNumber(const char*& p, const char* end, double& value) {
+#if defined(__cpp_lib_to_chars)
+        std::from_chars_result parsed = std::from_chars(p, end, value);
+        if (parsed.ec != std::errc() || (parsed.ptr < end && !isSpace(*parsed.ptr))) {
+            return false;
+        }
+        p = parsed.ptr;
+        return true;
+#else
+        char buffer[64];
+        const char* stop = p;
+        while (stop < end && !isSpace(*stop)) {
+            stop++;
+        }
+        size_t length = (size_t)(stop - p);
+        if (length == 0 || length >= sizeof(buffer)) {
+            return false;
+        }
+        memcpy(buffer, p, length);
+        buffer[length] = '\0';
+        char* parsedEnd;
+        value = strtod(buffer, &parsedEnd);
+        if (parsedEnd != buffer + length) {
+            return false;
+        }
+        p = stop;
+        return true;
+#endif
+    }
+
+    void appendNumber(std::string& out, double value) {
+        char buffer[64];
+#if defined(__cpp_lib_to_chars)
+        std::to_chars_result written = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, written.ptr);
+#else
+        int length = snprintf(buffer, sizeof(buffer), "%.17g", value);
+        out.append(buffer, (size_t)length);
+#endif
+    }
+
+    // Evaluates one chunk of whole lines. The last expression compiled is kept, since
+    // streams tend to repeat the same one.
+    class Evaluator {
+    public:
+        // Appends one output line per input line; returns the number of failed lines.
+        size_t run(const char* begin, const char* end, std::string& out) {
+            size_t failures = 0;
+            while (begin < end) {
+                const char* newline = (const char*)memchr(begin, '\n', (size_t)(end - begin));
+                const char* lineEnd = newline ? newline : end;
+                const char* stop = lineEnd;
+                while (stop > begin && (stop[-1] == '\r' || isSpace(stop[-1]))) {
+                    stop--;
+                }
+                if (!line(skipSpaces(begin, stop), stop, out)) {
+                    failures++;
+                }
+                out.push_back('\n');
+                begin = newline ? newline + 1 : end;
+            }
+            return failures;
+        }
+
+    private:
+        calc::Expression expression_;
+        std::string source_;
+        std::string error_;
+
+        bool line(const char* p, const char* end, std::string& out) {
+            if (p == end) {
+                return true;
+            }
+            const char* name = p;
+            while (p < end && isLetter(*p)) {
+                p++;
+            }
+            const Operation* op = (p == end || isSpace(*p)) ? findOperation(name, (size_t)(p - name)) : nullptr;
+            if (!op) {
+                return expression(name, end, out);
+            }
+            double operands[2];
+            for (int i = 0; i < op->arity; i++) {
+                p = skipSpaces(p, end);
+                if (p == end) {
+                    out += "error: ";
+                    out += op->name;
+                    out += op->arity == 1 ? " takes 1 operand" : " takes 2 operands";
+                    return false;
+                }
+                const char* start = p;
+                if (!parseNumber(p, end, operands[i])) {
+                    out += "error: invalid number '";
+                    while (p < end && !isSpace(*p)) {
+                        p++;
+                    }
+                    out.append(start, p);
+                    out += "'";
+                    return false;
+                }
+            }
+            if (skipSpaces(p, end) != end) {
+                out += "error: ";
+                out += op->name;
+                out += op->arity == 1 ? " takes 1 operand" : " takes 2 operands";
+                return false;
+            }
+            appendNumber(out, op->arity == 1 ? op->unary(operands[0]) : op->binary(operands[0], operands[1]));
+            return true;
+        }
+
+        bool expression(const char* begin, const char* end, std::string& out) {
+            if (!expression_.valid() || source_.size() != (size_t)(end - begin) || memcmp(source_.data(), begin, source_.size()) != 0) {
+                source_.assign(begin, end);
+                if (!expression_.compile(source_, &error_)) {
+                    out += "error: ";
+                    out += error_;
+                    return false;
+                }
+            }
+            if (!expression_.variables().empty()) {
+                out += "error: unbound variable '";
+                out += expression_.variables()[0];
+                out += "'";
+                return false;
+            }
+            appendNumber(out, expression_.evaluate(nullptr));
+            return true;
+        }
+    };
+
+    // Hands out numbered chunks of whole lines from a mapped file or a stream.
+    class Input {
+    public:
+        ~Input() {
+#ifndef _WIN32
+            if (map_) {
+                munmap((void*)map_, size_);
+            }
+#endif
+            if (file_ && file_ != stdin) {
+                fclose(file_);
+            }
+        }
+
+        bool open(const char* path) {
+            if (!path || strcmp(path, "-") == 0) {
+                file_ = stdin;
+                return true;
+            }
+#ifndef _WIN32
+            int fd = ::open(path, O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat info;
+            if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+                void* map = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map != MAP_FAILED) {
+                    madvise(map, (size_t)info.st_size, MADV_SEQUENTIAL);
+                    map_ = (const char*)map;
+                    size_ = (size_t)info.st_size;
+                    close(fd);
+                    return true;
+                }
+            }
+            close(fd);
+#endif
+            // Pipes, empty files and platforms without mmap are read as a stream
+            file_ = fopen(path, "rb");
+            return file_ != nullptr;
+        }
+
+        // Returns false once the input is exhausted (or unreadable; see failed()).
+        bool next(size_t& sequence, const char*& begin, const char*& end, std::vector<char>& storage) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (map_) {
+                if (offset_ >= size_) {
+                    return false;
+                }
+                size_t stop = offset_ + CHUNK_SIZE < size_ ? offset_ + CHUNK_SIZE : size_;
+                const char* newline = (const char*)memchr(map_ + stop, '\n', size_ - stop);
+                stop = newline ? (size_t)(newline - map_) + 1 : size_;
+                begin = map_ + offset_;
+                end = map_ + stop;
+                offset_ = stop;
+            } else {
+                if (!file_ || (feof(file_) && carry_.empty())) {
+                    return false;
+                }
+                storage.swap(carry_);
+                carry_.clear();
+                size_t used = storage.size();
+                storage.resize(used + CHUNK_SIZE);
+                size_t read = fread(storage.data() + used, 1, CHUNK_SIZE, file_);
+                storage.resize(used + read);
+                if (read < CHUNK_SIZE && ferror(file_)) {
+                    failed_ = true;
+                    return false;
+                }
+                // Keep a trailing partial line for the next chunk, unless this is the end
+                size_t keep = storage.size();
+                if (!feof(file_)) {
+                    while (keep > 0 && storage[keep - 1] != '\n') {
+                        keep--;
+                    }
+                }
+                carry_.assign(storage.begin() + keep, storage.end());
+                storage.resize(keep);
+                if (storage.empty() && feof(file_)) {
+                    return false;
+                }
+                begin = storage.data();
+                end = storage.data() + storage.size();
+            }
+            sequence = sequence_++;
+            return true;
+        }
+
+        bool failed() const { return failed_; }
+
+    private:
+        std::mutex mutex_;
+        const char* map_ = nullptr;
+        size_t size_ = 0;
+        size_t offset_ = 0;
+        FILE* file_ = nullptr;
+        std::vector<char> carry_;
+        size_t sequence_ = 0;
+        bool failed_ = false;
+    };
+
+    // Writes chunk results in sequence order. A chunk finished too far ahead of the next
+    // one due waits, which bounds the memory held by out-of-order results.
+    class Output {
+    public:
+        explicit Output(size_t window) : window_(window) {}
+
+        bool write(size_t sequence, std::string& text) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [&] { return failed_ || sequence < next_ + window_; });
+            if (failed_) {
+                return false;
+            }
+            pending_[sequence].swap(text);
+            while (!pending_.empty() && pending_.begin()->first == next_) {
+                std::string& chunk = pending_.begin()->second;
+                if (fwrite(chunk.data(), 1, chunk.size(), stdout) != chunk.size()) {
+                    failed_ = true;
+                }
+                pending_.erase(pending_.begin());
+                next_++;
+            }
+            ready_.notify_all();
+            return !failed_;
+        }
+
+        bool failed() const { return failed_; }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::map<size_t, std::string> pending_;
+        size_t next_ = 0;
+        size_t window_;
+        bool failed_ = false;
+    };
+}
+
+int runStream(const char* path, unsigned threads) {
+    Input input;
+    if (!input.open(path)) {
+        fprintf(stderr, "Cannot open '%s'\n", path);
+        return 1;
+    }
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+        threads = threads ? threads : 1;
+    }
+
+    Output output(2 * (size_t)threads);
+    std::atomic<size_t> failures{0};
+    auto work = [&] {
+        Evaluator evaluator;
+        std::vector<char> storage;
+        std::string text;
+        size_t sequence;
+        const char* begin;
+        const char* end;
+        while (input.next(sequence, begin, end, storage)) {
+            text.clear();
+            text.reserve((size_t)(end - begin) + (size_t)(end - begin) / 2);
+            failures += evaluator.run(begin, end, text);
+            if (!output.write(sequence, text)) {
+                return;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    fflush(stdout);
+
+    if (input.failed() || output.failed()) {
+        fprintf(stderr, "%s\n", input.failed() ? "Error reading input" : "Error writing output");
+        return 1;
+    }
+    if (failures) {
+        fprintf(stderr, "%zu line%s failed\n", failures.load(), failures == 1 ? "" : "s");
+        return 1;
+    }
+    return 0;
+}
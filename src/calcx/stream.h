@@ -0,0 +1,15 @@
+#pragma once
+
+// calcx --stream: evaluates one operation per line and writes one result per line.
+//
+// A line is either an operation and its operands separated by spaces ("add 1.5 2",
+// "pow 9 3", "sqrt 2") or a constant expression in calc::Expression syntax
+// ("sqrt(2) * (1 + 3)"). Results are printed in the shortest form that reads back to
+// the same double. Blank lines are copied through; a line that fails to parse prints
+// "error: ..." in its place, so output line n always answers input line n.
+//
+// path is a file to map into memory, or "-"/nullptr for stdin. Input is cut into
+// chunks of whole lines that threads evaluate in parallel; chunks are written in
+// input order. threads = 0 uses one per hardware thread. Returns the process exit
+// code: 0, or 1 if any line failed or the input could not be read.
+int runStream(const char* path, unsigned threads);
@@ -0,0 +1,128 @@
+#include "graphics/graphics.h"
+#include <algorithm>
+#include <string.h>
+#include <SDL3/SDL.h>
+
+namespace graphics {
+    Canvas::Canvas(SDL_Surface* surface)
+        : surface_(surface), pixels_(nullptr), pitch_(0), bytesPerPixel_(0), width_(0), height_(0),
+          clip_{0, 0, 0, 0}, locked_(false) {
+        if (!surface || SDL_ISPIXELFORMAT_FOURCC(surface->format)) return;
+        int bytesPerPixel = SDL_BYTESPERPIXEL(surface->format);
+        if (bytesPerPixel < 1 || bytesPerPixel > 4) return;
+        if (SDL_MUSTLOCK(surface)) {
+            if (!SDL_LockSurface(surface)) return;
+            locked_ = true;
+        }
+        if (!surface->pixels) return;
+
+        pixels_ = (Uint8*)surface->pixels;
+        pitch_ = surface->pitch;
+        bytesPerPixel_ = bytesPerPixel;
+        width_ = surface->w;
+        height_ = surface->h;
+        SDL_GetSurfaceClipRect(surface, &clip_);
+    }
+
+    Canvas::Canvas(Canvas& parent, const SDL_Rect& rect)
+        : surface_(parent.surface_), pixels_(parent.pixels_), pitch_(parent.pitch_),
+          bytesPerPixel_(parent.bytesPerPixel_), width_(parent.width_), height_(parent.height_),
+          clip_{0, 0, 0, 0}, locked_(false) {
+        if (!SDL_GetRectIntersection(&rect, &parent.clip_, &clip_)) {
+            clip_ = SDL_Rect{0, 0, 0, 0};
+        }
+    }
+
+    Canvas::~Canvas() {
+        if (locked_) {
+            SDL_UnlockSurface(surface_);
+        }
+    }
+
+    void Canvas::setClip(const SDL_Rect* rect) {
+        if (!pixels_) return;
+        SDL_Rect bounds = {0, 0, width_, height_};
+        if (!rect || !SDL_GetRectIntersection(rect, &bounds, &clip_)) {
+            clip_ = rect ? SDL_Rect{0, 0, 0, 0} : bounds;
+        }
+    }
+
+    void Canvas::fillSpan(int y, int x0, int x1, Uint32 color) {
+        if (y < clip_.y || y >= clip_.y + clip_.h) return;
+        x0 = std::max(x0, clip_.x);
+        x1 = std::min(x1, clip_.x + clip_.w);
+        if (x0 >= x1) return;
+        writeRun(pixels_ + (size_t)y * pitch_ + (size_t)x0 * bytesPerPixel_, x1 - x0, color);
+    }
+
+    void Canvas::fillRect(const SDL_Rect& rect, Uint32 color) {
+        int x0 = std::max(rect.x, clip_.x);
+        int x1 = std::min(rect.x + rect.w, clip_.x + clip_.w);
+        int y0 = std::max(rect.y, clip_.y);
+        int y1 = std::min(rect.y + rect.h, clip_.y + clip_.h);
+        if (x0 >= x1 || y0 >= y1) return;
+        Uint8* row = pixels_ + (size_t)y0 * pitch_ + (size_t)x0 * bytesPerPixel_;
+        for (int y = y0; y < y1; y++, row += pitch_) {
+            writeRun(row, x1 - x0, color);
+        }
+    }
+
+    void Canvas::blit(const void* pixels, int pitch, int width, int height, int x, int y) {
+        int x0 = std::max(x, clip_.x);
+        int x1 = std::min(x + width, clip_.x + clip_.w);
+        int y0 = std::max(y, clip_.y);
+        int y1 = std::min(y + height, clip_.y + clip_.h);
+        if (x0 >= x1 || y0 >= y1) return;
+        const Uint8* source = (const Uint8*)pixels + (size_t)(y0 - y) * pitch + (size_t)(x0 - x) * bytesPerPixel_;
+        Uint8* row = pixels_ + (size_t)y0 * pitch_ + (size_t)x0 * bytesPerPixel_;
+        size_t bytes = (size_t)(x1 - x0) * bytesPerPixel_;
+        for (int r = y0; r < y1; r++, row += pitch_, source += pitch) {
+            memcpy(row, source, bytes);
+        }
+    }
+
+    void Canvas::writePixel(Uint8* pixel, Uint32 color) const {
+        switch (bytesPerPixel_) {
+        case 1:
+            *pixel = (Uint8)color;
+            break;
+        case 2:
+            *(Uint16*)pixel = (Uint16)color;
+            break;
+        case 3:
+            // Packed 24-bit pixels keep the low three bytes of the value in memory order
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+            pixel[0] = (Uint8)color;
+            pixel[1] = (Uint8)(color >> 8);
+            pixel[2] = (Uint8)(color >> 16);
+#else
+            pixel[0] = (Uint8)(color >> 16);
+            pixel[1] = (Uint8)(color >> 8);
+            pixel[2] = (Uint8)color;
+#endif
+            break;
+        default:
+            *(Uint32*)pixel = color;
+            break;
+        }
+    }
+
+    void Canvas::writeRun(Uint8* start, int count, Uint32 color) const {
+        switch (bytesPerPixel_) {
+        case 4:
+            std::fill_n((Uint32*)start, count, color);
+            break;
+        case 2:
+            std::fill_n((Uint16*)start, count, (Uint16)color);
+            break;
+        case 1:
+            memset(start, (Uint8)color, count);
+            break;
+        default:
+            for (int i = 0; i < count; i++, start += bytesPerPixel_) {
+                writePixel(start, color);
+            }
+            break;
+        }
+    }
+}
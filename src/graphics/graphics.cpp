@@ -23,6 +23,17 @@ namespace graphics {
     }
 
     void drawRays(SDL_Surface* surface, Circle sun, struct Ray rays[RAY_COUNT], Uint32 color, Circle planets[PLANET_COUNT]) {
+        Canvas canvas(surface);
+        drawRays(canvas, sun, rays, color, planets);
+    }
+
+    void drawRays(Canvas& canvas, Circle sun, struct Ray rays[RAY_COUNT], Uint32 color, Circle planets[PLANET_COUNT]) {
+        int lengths[RAY_COUNT];
+        traceRays(rays, planets, canvas.getWidth(), canvas.getHeight(), lengths);
+        drawRays(canvas, rays, lengths, color);
+    }
+
+    void traceRays(struct Ray rays[RAY_COUNT], Circle planets[PLANET_COUNT], int width, int height, int lengths[RAY_COUNT]) {
         for (int i = 0; i < RAY_COUNT; i++) {
             struct Ray ray = rays[i];
             bool is_outside_window = false;
@@ -30,19 +41,19 @@ namespace graphics {
             int step = 1; // Step size for ray length
             double xc = ray.x;
             double yc = ray.y;
+            int length = 0;
             while (!is_outside_window && !is_blocked) {
                 double angle = ray.a; // Convert angle to radians
                 xc += cos(angle) * step; // Calculate end point of the ray
                 yc += sin(angle) * step; // Calculate end point of the ray
-                SDL_Rect pixel = {(int)xc, (int)yc, 1, 1};
-                SDL_FillSurfaceRect(surface, &pixel, color); // Draw the ray
-                if (xc < 0 || xc >= surface->w || yc < 0 || yc >= surface->h) {
+                length++; // The pixel at this step is drawn either way
+                if (xc < 0 || xc >= width || yc < 0 || yc >= height) {
                     is_outside_window = true; // Ray is outside the window
                 }
 
                 // Check if the ray intersects with any planet
                 for (int j = 0; j < PLANET_COUNT; j++) {
-                    Circle planet = planets[j];
+                    const Circle& planet = planets[j];
                     double dx = xc - planet.getX();
                     double dy = yc - planet.getY();
                     double distance_squared = dx * dx + dy * dy;
@@ -53,6 +64,39 @@ namespace graphics {
                     }
                 }
             }
+            lengths[i] = length;
         }
     }
-}
\ No newline at end of file
+
+    void drawRays(Canvas& canvas, struct Ray rays[RAY_COUNT], const int lengths[RAY_COUNT], Uint32 color) {
+        const SDL_Rect& clip = canvas.getClip();
+        for (int i = 0; i < RAY_COUNT; i++) {
+            SDL_Rect bounds = rayBounds(rays[i], 0, lengths[i]);
+            if (!SDL_HasRectIntersection(&bounds, &clip)) continue;
+            // Stepped exactly as traceRays steps, so the pixels match
+            double dx = cos(rays[i].a);
+            double dy = sin(rays[i].a);
+            double xc = rays[i].x;
+            double yc = rays[i].y;
+            for (int step = 0; step < lengths[i]; step++) {
+                xc += dx;
+                yc += dy;
+                canvas.setPixel((int)xc, (int)yc, color); // Draw the ray
+            }
+        }
+    }
+
+    SDL_Rect rayBounds(const struct Ray& ray, int from, int to) {
+        double x0 = ray.x + cos(ray.a) * from;
+        double y0 = ray.y + sin(ray.a) * from;
+        double x1 = ray.x + cos(ray.a) * to;
+        double y1 = ray.y + sin(ray.a) * to;
+        // Pixels come from truncating positions stepped one at a time; the spare pixel
+        // on each side absorbs both
+        int left = (int)floor(std::min(x0, x1)) - 1;
+        int top = (int)floor(std::min(y0, y1)) - 1;
+        int right = (int)floor(std::max(x0, x1)) + 1;
+        int bottom = (int)floor(std::max(y0, y1)) + 1;
+        return SDL_Rect{left, top, right - left + 1, bottom - top + 1};
+    }
+}
@@ -0,0 +1,242 @@
+#include "graphics/graphics.h"
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+
+namespace graphics {
+    namespace {
+        // Coordinates and radii beyond this are far off any surface; it keeps the
+        // squares below in range
+        const double MAX_EXTENT = 1 << 30;
+
+        // floor(sqrt(v)) for v >= 0
+        long long isqrt(long long v) {
+            long long root = (long long)std::sqrt((double)v);
+            while (root * root > v) root--;
+            while ((root + 1) * (root + 1) <= v) root++;
+            return root;
+        }
+
+        // Triangle vertices are snapped to 1/16 pixel; pixel (x, y) is sampled at its
+        // center, (16x + 8, 16y + 8) in those units
+        const int SUBPIXEL_BITS = 4;
+        const int64_t SUBPIXELS = 1 << SUBPIXEL_BITS;
+        // Vertices further out than this are skipped; it keeps edge functions in 64 bits
+        const double TRIANGLE_EXTENT = 1 << 24;
+        // Within this, an edge function changes by less than 2^27 across a block, so the
+        // blocks an edge crosses can be evaluated in 32-bit lanes
+        const double NARROW_EXTENT = 1 << 14;
+        const int BLOCK = 8;
+
+        // E(x, y) = a x + b y + c at the center of pixel (x, y): >= 0 on the inner side
+        // of the edge, and on the edge itself only if it is a top or left edge
+        struct EdgeFunction {
+            int64_t a, b, c;
+
+            int64_t at(int64_t x, int64_t y) const { return a * x + b * y + c; }
+        };
+
+        EdgeFunction edgeFunction(int64_t x0, int64_t y0, int64_t x1, int64_t y1) {
+            int64_t dx = x1 - x0;
+            int64_t dy = y1 - y0;
+            // With the vertices in clockwise screen order (y down), the inside is on the
+            // right of every edge; top edges run in +x, left edges run upwards
+            bool topLeft = dy < 0 || (dy == 0 && dx > 0);
+            EdgeFunction edge;
+            edge.a = -dy * SUBPIXELS;
+            edge.b = dx * SUBPIXELS;
+            edge.c = dx * (SUBPIXELS / 2 - y0) - dy * (SUBPIXELS / 2 - x0) - (topLeft ? 0 : 1);
+            return edge;
+        }
+
+        // Edge values at the pixels of one block row, stepped down the block. Edges that
+        // cover the whole block hold zeros. Blocks at the right of the bounding box or
+        // clip are narrower than BLOCK.
+        template<typename Lane>
+        struct BlockRow {
+            Lane values[3][BLOCK];
+            Lane rowStep[3];
+            int width;
+
+            // First covered pixel and how many are covered. A triangle row is convex, so
+            // they are one run, whose start follows from the count and the sum of the
+            // indices; plain sums and no branches let the compiler vectorize the loop
+            // (which a constant trip count would have it unroll instead).
+            void coveredRun(int& first, int& count) const {
+                Lane covered = 0;
+                Lane indexSum = 0;
+                for (Lane i = 0; i < width; i++) {
+                    Lane inside = values[0][i] | values[1][i] | values[2][i];
+                    Lane hit = -(Lane)(inside >= 0);
+                    covered -= hit;
+                    indexSum += hit & i;
+                }
+                count = (int)covered;
+                first = count ? (int)(indexSum - covered * (covered - 1) / 2) / count : BLOCK;
+            }
+
+            void next() {
+                for (int k = 0; k < 3; k++) {
+                    for (int i = 0; i < width; i++) {
+                        values[k][i] += rowStep[k];
+                    }
+                }
+            }
+        };
+
+        template<typename Lane>
+        void rasterize(Canvas& canvas, const EdgeFunction edges[3], int minX, int minY, int maxX, int maxY, Uint32 color) {
+            // An edge function is linear, so its extremes over a block are at the
+            // corners: the top left one plus these offsets. Blocks clipped to fewer
+            // pixels use the same offsets, which only makes them look more partial.
+            int64_t lowOffset[3];
+            int64_t highOffset[3];
+            for (int k = 0; k < 3; k++) {
+                int64_t spanX = edges[k].a * (BLOCK - 1);
+                int64_t spanY = edges[k].b * (BLOCK - 1);
+                lowOffset[k] = std::min<int64_t>(spanX, 0) + std::min<int64_t>(spanY, 0);
+                highOffset[k] = std::max<int64_t>(spanX, 0) + std::max<int64_t>(spanY, 0);
+            }
+
+            int rowStart[BLOCK];
+            int rowEnd[BLOCK];
+            for (int blockY = minY; blockY <= maxY; blockY += BLOCK) {
+                int height = std::min(BLOCK, maxY - blockY + 1);
+                std::fill(rowStart, rowStart + height, INT32_MAX);
+                std::fill(rowEnd, rowEnd + height, INT32_MIN);
+                int64_t corner[3];
+                for (int k = 0; k < 3; k++) {
+                    corner[k] = edges[k].at(minX, blockY) - edges[k].a * BLOCK;
+                }
+
+                for (int blockX = minX; blockX <= maxX; blockX += BLOCK) {
+                    int width = std::min(BLOCK, maxX - blockX + 1);
+                    bool rejected = false;
+                    bool partial[3];
+                    for (int k = 0; k < 3; k++) {
+                        corner[k] += edges[k].a * BLOCK;
+                        rejected |= corner[k] + highOffset[k] < 0;
+                        partial[k] = corner[k] + lowOffset[k] < 0;
+                    }
+                    if (rejected) continue;
+
+                    if (!partial[0] && !partial[1] && !partial[2]) {
+                        for (int r = 0; r < height; r++) {
+                            rowStart[r] = std::min(rowStart[r], blockX);
+                            rowEnd[r] = std::max(rowEnd[r], blockX + width);
+                        }
+                        continue;
+                    }
+
+                    // Within NARROW_EXTENT the values of an edge crossing the block fit
+                    // the 32-bit lanes
+                    BlockRow<Lane> row;
+                    for (int k = 0; k < 3; k++) {
+                        Lane value = partial[k] ? (Lane)corner[k] : 0;
+                        Lane step = partial[k] ? (Lane)edges[k].a : 0;
+                        for (int i = 0; i < BLOCK; i++) {
+                            row.values[k][i] = value + i * step;
+                        }
+                        row.rowStep[k] = partial[k] ? (Lane)edges[k].b : 0;
+                    }
+                    row.width = width;
+                    for (int r = 0; r < height; r++, row.next()) {
+                        int first, count;
+                        row.coveredRun(first, count);
+                        if (count > 0) {
+                            rowStart[r] = std::min(rowStart[r], blockX + first);
+                            rowEnd[r] = std::max(rowEnd[r], blockX + first + count);
+                        }
+                    }
+                }
+
+                for (int r = 0; r < height; r++) {
+                    if (rowStart[r] < rowEnd[r]) {
+                        canvas.fillSpan(blockY + r, rowStart[r], rowEnd[r], color);
+                    }
+                }
+            }
+        }
+    }
+
+    void fillCircle(Canvas& canvas, double x, double y, double radius, Uint32 color) {
+        if (!(radius >= 0) || !canvas.isValid()) return;
+        if (radius > MAX_EXTENT || !(std::fabs(x) <= MAX_EXTENT) || !(std::fabs(y) <= MAX_EXTENT)) return;
+        const SDL_Rect& clip = canvas.getClip();
+        long long cx = std::llround(x);
+        long long cy = std::llround(y);
+        long long limit = (long long)(radius * radius + radius);
+        long long reach = isqrt(limit);
+        long long top = std::max(cy - reach, (long long)clip.y);
+        long long bottom = std::min(cy + reach, (long long)clip.y + clip.h - 1);
+        if (top > bottom || cx + reach < clip.x || cx - reach >= clip.x + clip.w) return;
+
+        // The half-width only changes by the few pixels the boundary moves between
+        // neighbouring rows, so it is stepped rather than recomputed
+        long long dy = top - cy;
+        long long half = isqrt(limit - dy * dy);
+        for (long long row = top; row <= bottom; row++, dy++) {
+            long long rest = limit - dy * dy;
+            while (half * half > rest) half--;
+            while ((half + 1) * (half + 1) <= rest) half++;
+            long long left = std::max(cx - half, (long long)clip.x);
+            long long right = std::min(cx + half + 1, (long long)clip.x + clip.w);
+            canvas.fillSpan((int)row, (int)left, (int)right, color);
+        }
+    }
+
+    void fillTriangle(Canvas& canvas, double x1, double y1, double x2, double y2, double x3, double y3, Uint32 color) {
+        if (!canvas.isValid()) return;
+        double coordinates[6] = {x1, y1, x2, y2, x3, y3};
+        bool narrow = true;
+        for (double coordinate : coordinates) {
+            if (!(std::fabs(coordinate) <= TRIANGLE_EXTENT)) return;
+            narrow = narrow && std::fabs(coordinate) <= NARROW_EXTENT;
+        }
+        int64_t vertices[6];
+        for (int i = 0; i < 6; i++) {
+            vertices[i] = std::llround(coordinates[i] * SUBPIXELS);
+        }
+
+        // Twice the signed area; make the order clockwise on screen
+        int64_t area = (vertices[2] - vertices[0]) * (vertices[5] - vertices[1]) - (vertices[3] - vertices[1]) * (vertices[4] - vertices[0]);
+        if (area == 0) return;
+        if (area < 0) {
+            std::swap(vertices[2], vertices[4]);
+            std::swap(vertices[3], vertices[5]);
+        }
+        EdgeFunction edges[3] = {
+            edgeFunction(vertices[0], vertices[1], vertices[2], vertices[3]),
+            edgeFunction(vertices[2], vertices[3], vertices[4], vertices[5]),
+            edgeFunction(vertices[4], vertices[5], vertices[0], vertices[1])
+        };
+
+        // Pixels whose centers can fall inside, clipped
+        const SDL_Rect& clip = canvas.getClip();
+        int64_t lowX = std::min({vertices[0], vertices[2], vertices[4]});
+        int64_t highX = std::max({vertices[0], vertices[2], vertices[4]});
+        int64_t lowY = std::min({vertices[1], vertices[3], vertices[5]});
+        int64_t highY = std::max({vertices[1], vertices[3], vertices[5]});
+        int minX = (int)std::max<int64_t>(lowX >> SUBPIXEL_BITS, clip.x);
+        int maxX = (int)std::min<int64_t>(highX >> SUBPIXEL_BITS, clip.x + clip.w - 1);
+        int minY = (int)std::max<int64_t>(lowY >> SUBPIXEL_BITS, clip.y);
+        int maxY = (int)std::min<int64_t>(highY >> SUBPIXEL_BITS, clip.y + clip.h - 1);
+        if (minX > maxX || minY > maxY) return;
+
+        if (narrow) {
+            rasterize<int32_t>(canvas, edges, minX, minY, maxX, maxY, color);
+        } else {
+            rasterize<int64_t>(canvas, edges, minX, minY, maxX, maxY, color);
+        }
+    }
+
+    void fillTriangles(Canvas& canvas, const double* points, const uint32_t* indices, size_t count, Uint32 color) {
+        for (size_t t = 0; t < count; t++) {
+            size_t i0 = indices ? indices[3 * t] : 3 * t;
+            size_t i1 = indices ? indices[3 * t + 1] : 3 * t + 1;
+            size_t i2 = indices ? indices[3 * t + 2] : 3 * t + 2;
+            fillTriangle(canvas, points[2 * i0], points[2 * i0 + 1], points[2 * i1], points[2 * i1 + 1],
+                         points[2 * i2], points[2 * i2 + 1], color);
+        }
+    }
+}
@@ -2,12 +2,53 @@
 #include <algorithm>
 #include <cmath>
 #include <SDL3/SDL.h>
+#include "pool.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
 namespace graphics {
+    namespace {
+        // Bounds are clamped to this, far beyond any surface
+        const double MAX_BOUNDS = 1 << 30;
+
+        // Pixels floor(minX)..floor(maxX) by floor(minY)..floor(maxY)
+        SDL_Rect boundsOf(double minX, double minY, double maxX, double maxY) {
+            if (!(minX <= maxX) || !(minY <= maxY)) return SDL_Rect{0, 0, 0, 0};
+            int x0 = (int)std::floor(std::max(minX, -MAX_BOUNDS));
+            int y0 = (int)std::floor(std::max(minY, -MAX_BOUNDS));
+            int x1 = (int)std::floor(std::min(maxX, MAX_BOUNDS));
+            int y1 = (int)std::floor(std::min(maxY, MAX_BOUNDS));
+            return SDL_Rect{x0, y0, x1 - x0 + 1, y1 - y0 + 1};
+        }
+
+        long long area(const SDL_Rect& rect) {
+            return (long long)rect.w * rect.h;
+        }
+
+        SDL_Rect unionOf(const SDL_Rect& a, const SDL_Rect& b) {
+            SDL_Rect result;
+            SDL_GetRectUnion(&a, &b, &result);
+            return result;
+        }
+
+        // Merging is worth it while the union costs fewer extra pixels than this
+        const long long RECT_COST = 64 * 64;
+        // Beyond this many rectangles, merging pays regardless
+        const size_t MAX_RECTS = 16;
+        // Damage in more pieces than this is nearly everywhere; it becomes one rectangle
+        const size_t MAX_MERGE_INPUT = 48;
+
+        // Scenes with fewer shapes than this are not worth handing to the pool
+        const size_t PARALLEL_SHAPES = 256;
+
+        // Tiles a shape overlaps, inclusive
+        struct TileRange {
+            int x0, y0, x1, y1;
+        };
+    }
+
 
     uint32_t generateRandomUint32Color() {
         // RAND_MAX is typically at least 32767 (2^15 - 1).
@@ -44,7 +85,7 @@ namespace graphics {
     Shape::Shape(double x, double y, Uint32 color, const ShapeOptions& options)
         : x_(x), y_(y), color_(color), isSelected_(false), visible_(options.visible),
           selectable_(options.selectable), draggable_(options.draggable), 
-          clickable_(options.clickable), zOrder_(options.zOrder), isDragging_(false),
+          clickable_(options.clickable), zOrder_(options.zOrder), isDragging_(false), dirty_(true),
           onClickAction_(options.onClickAction), onDoubleClickAction_(options.onDoubleClickAction),
           onDragAction_(options.onDragAction), onHoverAction_(options.onHoverAction) {
             // generate random highlight color if not set
@@ -58,11 +99,18 @@ namespace graphics {
     void Shape::setPosition(double x, double y) {
         x_ = x;
         y_ = y;
+        dirty_ = true;
     }
 
     void Shape::move(double deltaX, double deltaY) {
         x_ += deltaX;
         y_ += deltaY;
+        dirty_ = true;
+    }
+
+    void Shape::draw(SDL_Surface* surface) {
+        Canvas canvas(surface);
+        draw(canvas);
     }
 
     void Shape::drawShape(SDL_Surface* surface) {
@@ -113,6 +161,7 @@ namespace graphics {
 
     void Shape::setColorHighlight(Uint32 color) {
         colorHighlight_ = color;
+        dirty_ = true;
     }
 
     //=============================================================================
@@ -128,25 +177,17 @@ namespace graphics {
         draw(surface);
     }
 
-    void Circle::draw(SDL_Surface* surface) {
+    void Circle::draw(Canvas& canvas) {
         if (!visible_) return;
 
-        // Draw filled circle using the same algorithm as legacy drawCircle
-        double rsq = radius_ * radius_;
-        double x_end = x_ + radius_;
-        double y_end = y_ + radius_;
-        
-        for (double x = x_ - radius_; x <= x_end; x++) {
-            for (double y = y_ - radius_; y <= y_end; y++) {
-                if ((x - x_) * (x - x_) + (y - y_) * (y - y_) <= rsq) {
-                    if (x >= 0 && x < surface->w && y >= 0 && y < surface->h) {
-                        SDL_Rect pixel = {(int)x, (int)y, 1, 1};
-                        Uint32 drawColor = isSelected_ ? (colorHighlight_) : color_; // Highlight selected
-                        SDL_FillSurfaceRect(surface, &pixel, drawColor);
-                    }
-                }
-            }
-        }
+        Uint32 drawColor = isSelected_ ? (colorHighlight_) : color_; // Highlight selected
+        fillCircle(canvas, x_, y_, radius_, drawColor);
+    }
+
+    SDL_Rect Circle::getBounds() const {
+        if (!visible_ || !(radius_ >= 0)) return SDL_Rect{0, 0, 0, 0};
+        // fillCircle rounds the center and reaches at most radius + 1/2 from it
+        return boundsOf(x_ - radius_ - 1, y_ - radius_ - 1, x_ + radius_ + 1, y_ + radius_ + 1);
     }
 
     bool Circle::contains(double x, double y) const {
@@ -183,7 +224,7 @@ namespace graphics {
         draw(surface);
     }
 
-    void Rectangle::draw(SDL_Surface* surface) {
+    void Rectangle::draw(Canvas& canvas) {
         if (!visible_) return;
 
         SDL_Rect rect = {
@@ -194,7 +235,17 @@ namespace graphics {
         };
         
         Uint32 drawColor = isSelected_ ? (color_ | 0xFF000000) : color_; // Highlight selected
-        SDL_FillSurfaceRect(surface, &rect, drawColor);
+        canvas.fillRect(rect, drawColor);
+    }
+
+    SDL_Rect Rectangle::getBounds() const {
+        if (!visible_) return SDL_Rect{0, 0, 0, 0};
+        return SDL_Rect{
+            (int)(x_ - width_ / 2),
+            (int)(y_ - height_ / 2),
+            (int)width_,
+            (int)height_
+        };
     }
 
     bool Rectangle::contains(double x, double y) const {
@@ -254,6 +305,7 @@ namespace graphics {
         x3_ += deltaX;
         y3_ += deltaY;
         updateCentroid();
+        dirty_ = true;
     }
 
     void Triangle::getVertices(double& x1, double& y1, double& x2, double& y2, double& x3, double& y3) const {
@@ -262,31 +314,18 @@ namespace graphics {
         x3 = x3_; y3 = y3_;
     }
 
-    void Triangle::draw(SDL_Surface* surface) {
+    void Triangle::draw(Canvas& canvas) {
         if (!visible_) return;
 
-        // Simple triangle drawing using barycentric coordinates
-        int minX = (int)std::min({x1_, x2_, x3_});
-        int maxX = (int)std::max({x1_, x2_, x3_});
-        int minY = (int)std::min({y1_, y2_, y3_});
-        int maxY = (int)std::max({y1_, y2_, y3_});
-
-        // Clamp to surface bounds
-        minX = std::max(0, minX);
-        maxX = std::min(surface->w - 1, maxX);
-        minY = std::max(0, minY);
-        maxY = std::min(surface->h - 1, maxY);
-
         Uint32 drawColor = isSelected_ ? (color_ | 0xFF000000) : color_;
+        fillTriangle(canvas, x1_, y1_, x2_, y2_, x3_, y3_, drawColor);
+    }
 
-        for (int y = minY; y <= maxY; y++) {
-            for (int x = minX; x <= maxX; x++) {
-                if (contains(x, y)) {
-                    SDL_Rect pixel = {x, y, 1, 1};
-                    SDL_FillSurfaceRect(surface, &pixel, drawColor);
-                }
-            }
-        }
+    SDL_Rect Triangle::getBounds() const {
+        if (!visible_) return SDL_Rect{0, 0, 0, 0};
+        // A pixel to spare for vertices snapping to 1/16 pixel
+        return boundsOf(std::min({x1_, x2_, x3_}) - 1, std::min({y1_, y2_, y3_}) - 1,
+                        std::max({x1_, x2_, x3_}) + 1, std::max({y1_, y2_, y3_}) + 1);
     }
 
     bool Triangle::contains(double x, double y) const {
@@ -448,11 +487,49 @@ namespace graphics {
         // Currently no time-based logic is needed
     }
 
+    //=============================================================================
+    // Damage Rectangles
+    //=============================================================================
+
+    void mergeRects(std::vector<SDL_Rect>& rects) {
+        rects.erase(std::remove_if(rects.begin(), rects.end(),
+                                   [](const SDL_Rect& rect) { return rect.w <= 0 || rect.h <= 0; }),
+                    rects.end());
+        if (rects.size() > MAX_MERGE_INPUT) {
+            SDL_Rect all = rects[0];
+            for (const SDL_Rect& rect : rects) {
+                all = unionOf(all, rect);
+            }
+            rects.assign(1, all);
+            return;
+        }
+
+        while (rects.size() > 1) {
+            size_t bestA = 0, bestB = 1;
+            long long bestExtra = 0;
+            for (size_t a = 0; a < rects.size(); a++) {
+                for (size_t b = a + 1; b < rects.size(); b++) {
+                    long long extra = area(unionOf(rects[a], rects[b])) - area(rects[a]) - area(rects[b]);
+                    if ((a == 0 && b == 1) || extra < bestExtra) {
+                        bestA = a;
+                        bestB = b;
+                        bestExtra = extra;
+                    }
+                }
+            }
+            if (bestExtra > RECT_COST && rects.size() <= MAX_RECTS) {
+                break;
+            }
+            rects[bestA] = unionOf(rects[bestA], rects[bestB]);
+            rects.erase(rects.begin() + bestB);
+        }
+    }
+
     //=============================================================================
     // ShapeManager Implementation
     //=============================================================================
 
-    ShapeManager::ShapeManager() {
+    ShapeManager::ShapeManager() : damageBounds_{0, 0, 0, 0}, damageAll_(true) {
     }
 
     std::shared_ptr<Circle> ShapeManager::createCircle(double x, double y, double radius, Uint32 color, const ShapeOptions& options) {
@@ -474,24 +551,41 @@ namespace graphics {
     }
 
     void ShapeManager::addShape(std::shared_ptr<Shape> shape) {
+        shape->setDirty(true);
         shapes_.push_back(shape);
         sortByZOrder();
     }
 
     void ShapeManager::removeShape(std::shared_ptr<Shape> shape) {
+        if (std::find(shapes_.begin(), shapes_.end(), shape) != shapes_.end()) {
+            forget(shape);
+        }
         shapes_.erase(std::remove(shapes_.begin(), shapes_.end(), shape), shapes_.end());
     }
 
     void ShapeManager::removeShapeAt(size_t index) {
         if (index < shapes_.size()) {
+            forget(shapes_[index]);
             shapes_.erase(shapes_.begin() + index);
         }
     }
 
     void ShapeManager::clear() {
+        for (const auto& shape : shapes_) {
+            forget(shape);
+        }
         shapes_.clear();
     }
 
+    // What a removed shape had on screen becomes damage
+    void ShapeManager::forget(const std::shared_ptr<Shape>& shape) {
+        auto found = drawnBounds_.find(shape.get());
+        if (found != drawnBounds_.end()) {
+            damage_.push_back(found->second);
+            drawnBounds_.erase(found);
+        }
+    }
+
     std::vector<std::shared_ptr<Shape>> ShapeManager::getVisibleShapes() const {
         std::vector<std::shared_ptr<Shape>> visibleShapes;
         for (const auto& shape : shapes_) {
@@ -569,9 +663,123 @@ namespace graphics {
     }
 
     void ShapeManager::drawAll(SDL_Surface* surface) {
+        Canvas canvas(surface);
+        drawAll(canvas);
+    }
+
+    void ShapeManager::drawAll(Canvas& canvas) {
+        const SDL_Rect& clip = canvas.getClip();
         for (const auto& shape : shapes_) {
-            shape->draw(surface);
+            SDL_Rect bounds = shape->getBounds();
+            if (SDL_HasRectIntersection(&bounds, &clip)) {
+                shape->draw(canvas);
+            }
+        }
+    }
+
+    void ShapeManager::drawAll(Canvas& canvas, const DrawOptions& options) {
+        unsigned threads = options.threads ? options.threads : pool::hardwareThreads();
+        const SDL_Rect& clip = canvas.getClip();
+        int tileSize = std::max(options.tileSize, 1);
+        if (threads <= 1 || shapes_.size() < PARALLEL_SHAPES || clip.w <= 0 || clip.h <= 0) {
+            drawAll(canvas);
+            return;
+        }
+        int tilesX = (clip.w + tileSize - 1) / tileSize;
+        int tilesY = (clip.h + tileSize - 1) / tileSize;
+        size_t tileCount = (size_t)tilesX * tilesY;
+
+        // Bin by counting sort: the tiles each shape overlaps, then every tile's
+        // shapes in drawing order
+        std::vector<TileRange> ranges(shapes_.size());
+        std::vector<size_t> binStarts(tileCount + 1, 0);
+        for (size_t i = 0; i < shapes_.size(); i++) {
+            SDL_Rect bounds = shapes_[i]->getBounds();
+            SDL_Rect visible;
+            if (!SDL_GetRectIntersection(&bounds, &clip, &visible)) {
+                ranges[i] = TileRange{0, 0, -1, -1};
+                continue;
+            }
+            TileRange& range = ranges[i];
+            range.x0 = (visible.x - clip.x) / tileSize;
+            range.y0 = (visible.y - clip.y) / tileSize;
+            range.x1 = (visible.x + visible.w - 1 - clip.x) / tileSize;
+            range.y1 = (visible.y + visible.h - 1 - clip.y) / tileSize;
+            for (int ty = range.y0; ty <= range.y1; ty++) {
+                for (int tx = range.x0; tx <= range.x1; tx++) {
+                    binStarts[(size_t)ty * tilesX + tx + 1]++;
+                }
+            }
+        }
+        for (size_t t = 0; t < tileCount; t++) {
+            binStarts[t + 1] += binStarts[t];
+        }
+        std::vector<uint32_t> binShapes(binStarts[tileCount]);
+        std::vector<size_t> next(binStarts.begin(), binStarts.end() - 1);
+        for (size_t i = 0; i < shapes_.size(); i++) {
+            const TileRange& range = ranges[i];
+            for (int ty = range.y0; ty <= range.y1; ty++) {
+                for (int tx = range.x0; tx <= range.x1; tx++) {
+                    binShapes[next[(size_t)ty * tilesX + tx]++] = (uint32_t)i;
+                }
+            }
+        }
+
+        pool::parallelFor(tileCount, threads, [&](size_t t) {
+            if (binStarts[t] == binStarts[t + 1]) return;
+            int tx = (int)(t % tilesX);
+            int ty = (int)(t / tilesX);
+            SDL_Rect rect = {clip.x + tx * tileSize, clip.y + ty * tileSize, tileSize, tileSize};
+            Canvas tile(canvas, rect);
+            for (size_t b = binStarts[t]; b < binStarts[t + 1]; b++) {
+                shapes_[binShapes[b]]->draw(tile);
+            }
+        });
+    }
+
+    void ShapeManager::invalidate(const SDL_Rect& rect) {
+        damage_.push_back(rect);
+    }
+
+    void ShapeManager::invalidateAll() {
+        damageAll_ = true;
+    }
+
+    std::vector<SDL_Rect> ShapeManager::takeDamage(const SDL_Rect& bounds) {
+        bool all = damageAll_ || !SDL_RectsEqual(&bounds, &damageBounds_);
+        damageAll_ = false;
+        damageBounds_ = bounds;
+
+        std::vector<SDL_Rect> damage;
+        for (const auto& shape : shapes_) {
+            if (!shape->isDirty()) continue;
+            SDL_Rect current = shape->getBounds();
+            auto found = drawnBounds_.find(shape.get());
+            if (found != drawnBounds_.end()) {
+                damage.push_back(found->second);
+                found->second = current;
+            } else {
+                drawnBounds_.emplace(shape.get(), current);
+            }
+            damage.push_back(current);
+            shape->setDirty(false);
+        }
+        damage.insert(damage.end(), damage_.begin(), damage_.end());
+        damage_.clear();
+
+        if (all) {
+            damage.assign(1, bounds);
+        }
+        size_t kept = 0;
+        for (const SDL_Rect& rect : damage) {
+            SDL_Rect visible;
+            if (SDL_GetRectIntersection(&rect, &bounds, &visible)) {
+                damage[kept++] = visible;
+            }
         }
+        damage.resize(kept);
+        mergeRects(damage);
+        return damage;
     }
 
     void ShapeManager::bringToFront(std::shared_ptr<Shape> shape) {
@@ -613,7 +821,7 @@ namespace graphics {
     }
 
     void ShapeManager::sortByZOrder() {
-        std::sort(shapes_.begin(), shapes_.end(), 
+        std::stable_sort(shapes_.begin(), shapes_.end(),
                   [](const std::shared_ptr<Shape>& a, const std::shared_ptr<Shape>& b) {
                       return a->getZOrder() > b->getZOrder(); // Higher Z-order first
                   });
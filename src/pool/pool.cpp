@@ -0,0 +1,127 @@
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "pool.h"
+
+namespace pool {
+    namespace {
+        thread_local bool insideTask = false;
+
+        // Workers sleep until a job is posted, take one of its seats, and pull indices
+        // from a shared counter until they run out.
+        class Pool {
+        public:
+            ~Pool() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stopping_ = true;
+                }
+                wake_.notify_all();
+                for (std::thread& worker : workers_) {
+                    worker.join();
+                }
+            }
+
+            void run(size_t count, unsigned threads, const std::function<void(size_t)>& task) {
+                std::unique_lock<std::mutex> busy(busy_, std::try_to_lock);
+                if (!busy.owns_lock()) {
+                    runInline(count, task);
+                    return;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    while (workers_.size() + 1 < threads) {
+                        workers_.emplace_back([this] { work(); });
+                    }
+                    task_ = &task;
+                    count_ = count;
+                    next_.store(0, std::memory_order_relaxed);
+                    seats_ = threads - 1;
+                    generation_++;
+                }
+                wake_.notify_all();
+
+                insideTask = true;
+                drain();
+                insideTask = false;
+
+                // Close the job to latecomers, then wait for the workers inside it
+                std::unique_lock<std::mutex> lock(mutex_);
+                seats_ = 0;
+                done_.wait(lock, [this] { return active_ == 0; });
+                task_ = nullptr;
+            }
+
+            static void runInline(size_t count, const std::function<void(size_t)>& task) {
+                for (size_t i = 0; i < count; i++) {
+                    task(i);
+                }
+            }
+
+        private:
+            std::mutex busy_;   // held by the thread whose job is posted
+            std::mutex mutex_;
+            std::condition_variable wake_;
+            std::condition_variable done_;
+            std::vector<std::thread> workers_;
+            const std::function<void(size_t)>* task_ = nullptr;
+            size_t count_ = 0;
+            std::atomic<size_t> next_{0};
+            unsigned seats_ = 0;
+            unsigned active_ = 0;
+            uint64_t generation_ = 0;
+            bool stopping_ = false;
+
+            void drain() {
+                for (size_t i = next_.fetch_add(1, std::memory_order_relaxed); i < count_; i = next_.fetch_add(1, std::memory_order_relaxed)) {
+                    (*task_)(i);
+                }
+            }
+
+            void work() {
+                insideTask = true;
+                uint64_t seen = 0;
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (true) {
+                    wake_.wait(lock, [&] { return stopping_ || (generation_ != seen && seats_ > 0); });
+                    if (stopping_) {
+                        return;
+                    }
+                    seen = generation_;
+                    seats_--;
+                    active_++;
+                    lock.unlock();
+                    drain();
+                    lock.lock();
+                    if (--active_ == 0) {
+                        done_.notify_all();
+                    }
+                }
+            }
+        };
+
+        Pool& instance() {
+            static Pool pool;
+            return pool;
+        }
+    }
+
+    unsigned hardwareThreads() {
+        unsigned count = std::thread::hardware_concurrency();
+        return count ? count : 1;
+    }
+
+    void parallelFor(size_t count, unsigned threads, const std::function<void(size_t)>& task) {
+        if (threads > count) {
+            threads = (unsigned)count;
+        }
+        if (threads <= 1 || insideTask) {
+            Pool::runInline(count, task);
+            return;
+        }
+        instance().run(count, threads, task);
+    }
+}
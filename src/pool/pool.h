@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+
+#ifdef _WIN32
+    #ifdef POOL_BUILDING_DLL
+        #define POOL_API __declspec(dllexport)
+    #elif defined(POOL_USING_DLL)
+        #define POOL_API __declspec(dllimport)
+    #else
+        #define POOL_API
+    #endif
+#else
+    #define POOL_API
+#endif
+
+// Fork-join worker pool. It is its own library, linked by both calc and graphics, so a
+// process has one set of workers however many of them it uses.
+namespace pool {
+    // Hardware threads available to the process (at least 1).
+    POOL_API unsigned hardwareThreads();
+
+    // Runs task(i) for every i in [0, count) on up to `threads` threads, the caller
+    // included, and returns once all have finished. Indices are handed out dynamically.
+    // Calls made from inside a task, or while another thread's call is running, execute
+    // serially on the calling thread.
+    POOL_API void parallelFor(size_t count, unsigned threads, const std::function<void(size_t)>& task);
+}
@@ -0,0 +1,67 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "calc/cpu.h"
+#include "calc/reduce.h"
+
+// Infinities and overflow must come out of the compensated reductions as +-inf, not as
+// the NaN their inf - inf error terms would give. Run once per CALC_ISA level.
+namespace {
+    int failures = 0;
+
+    void check(const char* what, double got, double expected) {
+        bool same = isnan(expected) ? isnan(got) : got == expected;
+        if (!same) {
+            fprintf(stderr, "FAIL %s: got %g, expected %g\n", what, got, expected);
+            failures++;
+        }
+    }
+
+    // Puts value at index at within n ones, so it lands in every lane and chunk position.
+    std::vector<double> onesWith(size_t n, size_t at, double value) {
+        std::vector<double> x(n, 1.0);
+        x[at] = value;
+        return x;
+    }
+}
+
+int main() {
+    const double inf = INFINITY;
+    const calc::ReduceOptions options[] = {
+        {1, true}, {4, true}, {1, false}, {4, false}
+    };
+    for (const calc::ReduceOptions& o : options) {
+        check("sum {1, inf, 2}", calc::sum(std::vector<double>{1, inf, 2}, o), inf);
+        check("sum {-inf, 1}", calc::sum(std::vector<double>{-inf, 1}, o), -inf);
+        check("sum {inf, -inf}", calc::sum(std::vector<double>{inf, -inf}, o), NAN);
+        check("sum {DBL_MAX, DBL_MAX}", calc::sum(std::vector<double>{DBL_MAX, DBL_MAX}, o), inf);
+        check("sum {-DBL_MAX, -DBL_MAX}", calc::sum(std::vector<double>{-DBL_MAX, -DBL_MAX}, o), -inf);
+        check("product {DBL_MAX, 2}", calc::product(std::vector<double>{DBL_MAX, 2}, o), inf);
+        check("product {1e200, -1e200}", calc::product(std::vector<double>{1e200, -1e200}, o), -inf);
+        check("product {2, inf}", calc::product(std::vector<double>{2, inf}, o), inf);
+        check("product {0, inf}", calc::product(std::vector<double>{0, inf}, o), NAN);
+        check("dot {inf, 1} {1, 1}", calc::dot(std::vector<double>{inf, 1}, std::vector<double>{1, 1}, o), inf);
+        check("dot {1e200, 1e200} {1e200, 1e200}",
+              calc::dot(std::vector<double>{1e200, 1e200}, std::vector<double>{1e200, 1e200}, o), inf);
+        check("dot {1e301} {-10}", calc::dot(std::vector<double>{1e301}, std::vector<double>{-10}, o), 1e301 * -10.0);
+
+        // Across lanes, chunk boundaries and threads
+        const size_t n = 200000;
+        for (size_t at : {(size_t)0, (size_t)5, (size_t)32768, n - 1}) {
+            check("sum of ones with inf", calc::sum(onesWith(n, at, inf), o), inf);
+            check("sum of ones with -DBL_MAX", calc::sum(onesWith(n, at, -DBL_MAX), o), -DBL_MAX + n - 1);
+            check("product of ones with inf", calc::product(onesWith(n, at, inf), o), inf);
+            check("dot of ones with inf", calc::dot(onesWith(n, at, -inf), std::vector<double>(n, 1.0), o), -inf);
+        }
+        std::vector<double> large(n, DBL_MAX / 4);
+        check("sum overflowing across chunks", calc::sum(large, o), inf);
+        std::vector<double> growing(n, 1.01);
+        check("product overflowing across chunks", calc::product(growing, o), inf);
+
+        // Finite inputs keep their compensation
+        check("sum {1e16, 1, -1e16}", calc::sum(std::vector<double>{1e16, 1, -1e16}, o), 1);
+    }
+    printf("reduce_test (%s): %s\n", calc::cpu::name(calc::cpu::active()), failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}